@@ -0,0 +1,475 @@
+// Cycle benchmarks for the firmware hot paths. Runs the profiling build
+// (make bench) under simavr, drives it with MIDI on the UART and encoder
+// and switch edges on PORTC, and prints a JSON report on stdout.
+//
+// Note on latency is measured here, from the RX interrupt of the last
+// byte of the message to the first SID chip select strobe. Everything
+// else comes from the firmware's own profile_stats block, read back from
+// simulated RAM by symbol.
+//
+// With -stress the firmware is fed MIDI back to back at the full 31250
+// baud (clock, controller and note traffic) for a few simulated seconds
+// while an encoder spins and the display redraws. The report has the
+// bytes lost and the receive ring high-water mark from the firmware's
+// uart_stats, and the latency from each note on reaching the UART to its
+// frequency write, decoded from the SID bus shift register pins.
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <algorithm>
+#include <vector>
+
+#include <sim_avr.h>
+#include <sim_elf.h>
+#include <avr_ioport.h>
+#include <avr_uart.h>
+
+#include "notes.h"
+#include "bench.h"
+
+static const uint32_t F_cpu        = 16000000;
+static const uint32_t Data_offset  = 0x800000;  // ELF address of SRAM
+static const uint32_t Rx_vector    = 18 * 4;    // USART_RX, byte address
+static const uint8_t  Hc595_data   = 1;         // PD1
+static const uint8_t  Hc595_clk    = 2;         // PD2
+static const uint8_t  Sid_cs       = 6;         // PD6
+static const uint8_t  Enc1_a       = 0;         // PC0
+static const uint8_t  Enc1_b       = 1;         // PC1
+static const uint8_t  Enc2_a       = 2;         // PC2
+static const uint8_t  Enc2_b       = 3;         // PC3
+static const uint8_t  Sw1          = 4;         // PC4
+static const uint8_t  Bench_notes  = 32;
+static const uint32_t Byte_us      = 320;       // 10 bits at 31250 baud
+
+static const uint8_t Num_probes       = sizeof (probe_names) / sizeof (probe_names[0]);
+static const uint8_t Probe_stats_size = 10;  // uint16 min, max, uint32 sum, uint16 runs
+static const uint8_t Cycles_per_count = 8;
+
+struct Bench
+{
+  avr_t *     avr;
+  avr_irq_t * rx;
+  avr_irq_t * portc[8];
+
+  uint32_t    strobes;
+  uint64_t    first_strobe;
+  uint64_t    last_strobe;
+
+  Sid_bus     bus;
+  void     (* on_write) (uint8_t address, uint8_t data);
+};
+
+static Bench bench;
+
+static void on_sid_cs (avr_irq_t * irq, uint32_t value, void * param)
+{
+  uint8_t address;
+  uint8_t data;
+
+  if (!bench.bus.select (value, address, data))
+    return;
+
+  if (bench.strobes == 0)
+    bench.first_strobe = bench.avr->cycle;
+
+  bench.last_strobe = bench.avr->cycle;
+  bench.strobes++;
+
+  if (bench.on_write)
+    bench.on_write (address, data);
+}
+
+static void on_hc595_data (avr_irq_t * irq, uint32_t value, void * param)
+{
+  bench.bus.data (value);
+}
+
+static void on_hc595_clk (avr_irq_t * irq, uint32_t value, void * param)
+{
+  bench.bus.clock (value);
+}
+
+static bool step ()
+{
+  int state = avr_run (bench.avr);
+  return state != cpu_Done && state != cpu_Crashed;
+}
+
+static void run_for (uint32_t us)
+{
+  uint64_t end = bench.avr->cycle + (uint64_t) us * (F_cpu / 1000000);
+
+  while (bench.avr->cycle < end && step ())
+  {
+  }
+}
+
+// Queues a MIDI message and returns the cycle at which the RX interrupt
+// for its last byte was taken, or 0 if it never was.
+static uint64_t send (const uint8_t * data, uint8_t length, uint32_t timeout_us)
+{
+  for (uint8_t i = 0; i < length; ++i)
+  {
+    avr_raise_irq (bench.rx, data[i]);
+  }
+
+  uint64_t end = bench.avr->cycle + (uint64_t) timeout_us * (F_cpu / 1000000);
+  uint8_t  seen = 0;
+
+  while (bench.avr->cycle < end && step ())
+  {
+    if (bench.avr->pc == Rx_vector && ++seen == length)
+      return bench.avr->cycle;
+  }
+
+  return 0;
+}
+
+static void set_pin (uint8_t pin, uint8_t value)
+{
+  avr_raise_irq (bench.portc[pin], value);
+}
+
+// One detent: two quarter steps, 1 ms apart
+static void turn (uint8_t a, uint8_t b, int8_t detents)
+{
+  for (int8_t d = 0; d < (detents < 0 ? -detents : detents); ++d)
+  {
+    for (uint8_t q = 0; q < 2; ++q)
+    {
+      uint8_t state = (detents > 0 ? encoder_cw : encoder_ccw)[(d & 1) * 2 + q];
+      set_pin (a, state >> 1);
+      set_pin (b, state & 1);
+      run_for (1000);
+    }
+  }
+}
+
+static const avr_symbol_t * find_symbol (const elf_firmware_t & f, const char * name)
+{
+  for (uint32_t i = 0; i < f.symbolcount; ++i)
+  {
+    if (!strcmp (f.symbol[i]->symbol, name))
+      return f.symbol[i];
+  }
+
+  return nullptr;
+}
+
+static const uint8_t * symbol_data (const elf_firmware_t & f, const char * name)
+{
+  auto symbol = find_symbol (f, name);
+  return symbol ? bench.avr->data + (symbol->addr - Data_offset) : nullptr;
+}
+
+static uint32_t read_le (const uint8_t * p, uint8_t n)
+{
+  uint32_t v = 0;
+
+  for (uint8_t i = 0; i < n; ++i)
+  {
+    v |= (uint32_t) p[i] << (8 * i);
+  }
+
+  return v;
+}
+
+static void print_stats (const char * name, const Stats & s, bool last)
+{
+  printf ("    \"%s\": { \"min\": %llu, \"avg\": %llu, \"max\": %llu, \"runs\": %u }%s\n",
+          name,
+          (unsigned long long) s.min,
+          (unsigned long long) (s.runs ? s.sum / s.runs : 0),
+          (unsigned long long) s.max,
+          s.runs,
+          last ? "" : ",");
+}
+
+// Cycle counts of the hot paths, one message at a time
+static int hot_paths (const elf_firmware_t & f, const char * name)
+{
+  auto data = symbol_data (f, "profile_stats");
+
+  if (!data)
+  {
+    fprintf (stderr, "bench: no profile_stats in %s, build with -DPROFILE\n", name);
+    return 1;
+  }
+
+  // Note on: RX interrupt of the velocity byte to the first CS strobe
+  Stats note_on {};
+
+  for (uint8_t i = 0; i < Bench_notes; ++i)
+  {
+    const uint8_t on[]  = { 0x90, (uint8_t) (36 + i), 0x64 };
+    const uint8_t off[] = { 0x80, (uint8_t) (36 + i), 0x00 };
+
+    uint64_t start = send (on, sizeof (on), 5000);
+    bench.strobes = 0;
+    run_for (2000);
+
+    if (start && bench.strobes)
+      note_on.add (bench.first_strobe - start);
+
+    send (off, sizeof (off), 5000);
+    run_for (2000);
+  }
+
+  // Patch flush: program change to the last register write it causes
+  Stats flush {};
+  uint32_t flush_writes = 0;
+
+  for (uint8_t program = 16; program < 23; ++program)
+  {
+    const uint8_t change[] = { 0xc0, program };
+
+    uint64_t start = send (change, sizeof (change), 5000);
+    bench.strobes = 0;
+    run_for (10000);
+
+    if (start && bench.strobes)
+    {
+      flush.add (bench.last_strobe - start);
+      flush_writes += bench.strobes;
+    }
+  }
+
+  // Menu renders and a save of user program 1
+  const uint8_t user[] = { 0xc0, 0 };
+  send (user, sizeof (user), 5000);
+  run_for (10000);
+
+  turn (Enc1_a, Enc1_b, 4);
+  turn (Enc1_a, Enc1_b, -4);
+  turn (Enc2_a, Enc2_b, 3);
+
+  set_pin (Sw1, 0);
+  run_for (20000);
+  set_pin (Sw1, 1);
+  run_for (200000);
+
+  printf ("{\n");
+  printf ("  \"firmware\": \"%s\",\n", name);
+  printf ("  \"f_cpu\": %u,\n", F_cpu);
+  printf ("  \"cycles\": %llu,\n", (unsigned long long) bench.avr->cycle);
+  printf ("  \"measured\": {\n");
+  print_stats ("note_on_to_cs", note_on, false);
+  print_stats ("patch_flush", flush, false);
+  printf ("    \"patch_flush_writes\": %u\n", flush.runs ? flush_writes / flush.runs : 0);
+  printf ("  },\n");
+  printf ("  \"probes\": {\n");
+
+  for (uint8_t i = 0; i < Num_probes; ++i)
+  {
+    auto p = data + i * Probe_stats_size;
+    uint32_t runs = read_le (p + 8, 2);
+    Stats s {};
+
+    if (runs)
+    {
+      s.min  = read_le (p, 2) * Cycles_per_count;
+      s.max  = read_le (p + 2, 2) * Cycles_per_count;
+      s.sum  = (uint64_t) read_le (p + 4, 4) * Cycles_per_count;
+      s.runs = runs;
+    }
+
+    print_stats (probe_names[i], s, i == Num_probes - 1);
+  }
+
+  printf ("  }\n");
+  printf ("}\n");
+
+  return 0;
+}
+
+static Note_latency notes_played;
+
+static void on_stress_write (uint8_t address, uint8_t data)
+{
+  notes_played.write (address, data, bench.avr->cycle);
+}
+
+// Back to back MIDI at the full baud rate with the UI busy
+static int stress (const elf_firmware_t & f, const char * name, uint32_t seconds)
+{
+  auto uart_stats = symbol_data (f, "uart_stats");
+
+  if (!uart_stats)
+  {
+    fprintf (stderr, "bench: no uart_stats in %s\n", name);
+    return 1;
+  }
+
+  // Clock, a mod wheel ramp and notes stepping through an octave, so that
+  // a frequency write tells which of the last twelve notes it plays. The
+  // morph starts disabled, so the ramp only goes through the controller
+  // map.
+  std::vector<uint8_t>  stream;
+  std::vector<uint32_t> note_ends;
+  std::vector<uint16_t> note_frequencies;
+
+  for (uint32_t i = 0; stream.size () < seconds * 1000000 / Byte_us; ++i)
+  {
+    const uint8_t note = 60 + (i >> 2) % 12;
+
+    stream.push_back (0xf8);
+    stream.insert (stream.end (), { 0xb0, 0x01, (uint8_t) (i & 0x7f) });
+
+    switch (i & 3)
+    {
+      case 0:
+        stream.insert (stream.end (), { 0x90, note, 0x64 });
+        note_ends.push_back (stream.size () - 1);
+        note_frequencies.push_back (note_frequency (note));
+        break;
+
+      case 2:
+        stream.insert (stream.end (), { 0x80, note, 0x00 });
+        break;
+    }
+  }
+
+  // Off the frequency row, so that the spinning encoder edits the voice
+  // shape and never writes the registers the latency is measured on
+  turn (Enc1_a, Enc1_b, 1);
+
+  avr_irq_register_notify (avr_io_getirq (bench.avr, AVR_IOCTL_IOPORT_GETIRQ ('D'), Hc595_data), on_hc595_data, nullptr);
+  avr_irq_register_notify (avr_io_getirq (bench.avr, AVR_IOCTL_IOPORT_GETIRQ ('D'), Hc595_clk), on_hc595_clk, nullptr);
+  bench.on_write = on_stress_write;
+
+  const uint64_t cycles_per_byte = (uint64_t) Byte_us * (F_cpu / 1000000);
+  const uint64_t cycles_per_step = 2000 * (F_cpu / 1000000);
+  const uint64_t start = bench.avr->cycle;
+
+  uint64_t next_byte = start;
+  uint64_t next_step = start;
+  uint32_t sent = 0;
+  uint32_t received = 0;
+  uint32_t steps = 0;
+  size_t   next_note = 0;
+
+  while (received < stream.size () && step ())
+  {
+    uint64_t now = bench.avr->cycle;
+
+    if (sent < stream.size () && now >= next_byte)
+    {
+      avr_raise_irq (bench.rx, stream[sent++]);
+      next_byte += cycles_per_byte;
+    }
+
+    // A quarter step every 2 ms, reversing every 32 detents
+    if (now >= next_step)
+    {
+      uint8_t state = ((steps >> 6) & 1 ? encoder_ccw : encoder_cw)[steps & 3];
+      set_pin (Enc2_a, state >> 1);
+      set_pin (Enc2_b, state & 1);
+      next_step += cycles_per_step;
+      steps++;
+    }
+
+    // Bytes the ring dropped still take their interrupt, so RX vector
+    // hits index the stream unless the UART itself overran
+    if (bench.avr->pc == Rx_vector)
+    {
+      if (next_note < note_ends.size () && note_ends[next_note] == received)
+      {
+        notes_played.note (now, note_frequencies[next_note]);
+        next_note++;
+      }
+
+      received++;
+    }
+
+    // Give up on a firmware that stopped taking bytes
+    if (sent == stream.size () && now > next_byte + F_cpu)
+      break;
+  }
+
+  run_for (20000);
+
+  const uint64_t elapsed = bench.avr->cycle - start;
+  std::vector<uint64_t> sorted (notes_played.latencies);
+  std::sort (sorted.begin (), sorted.end ());
+
+  auto us = [] (uint64_t cycles) { return (unsigned long long) (cycles / (F_cpu / 1000000)); };
+
+  printf ("{\n");
+  printf ("  \"firmware\": \"%s\",\n", name);
+  printf ("  \"f_cpu\": %u,\n", F_cpu);
+  printf ("  \"seconds\": %.3f,\n", (double) elapsed / F_cpu);
+  printf ("  \"bytes_sent\": %u,\n", sent);
+  printf ("  \"bytes_received\": %u,\n", received);
+  printf ("  \"encoder_steps\": %u,\n", steps);
+  printf ("  \"uart\": { \"dropped\": %u, \"overruns\": %u, \"high_water\": %u },\n",
+          read_le (uart_stats, 2),
+          read_le (uart_stats + 2, 2),
+          read_le (uart_stats + 4, 1));
+  printf ("  \"notes\": { \"sent\": %u, \"written\": %u, \"coalesced\": %u, \"lost\": %u, \"stray\": %u },\n",
+          (unsigned) note_ends.size (),
+          (unsigned) notes_played.latencies.size (),
+          notes_played.coalesced,
+          (unsigned) (note_ends.size () - notes_played.latencies.size () - notes_played.coalesced),
+          notes_played.stray);
+  printf ("  \"note_on_to_freq_us\": { \"p50\": %llu, \"p99\": %llu, \"max\": %llu }\n",
+          us (percentile (sorted, 50)),
+          us (percentile (sorted, 99)),
+          us (sorted.empty () ? 0 : sorted.back ()));
+  printf ("}\n");
+
+  return 0;
+}
+
+int main (int argc, char * argv[])
+{
+  bool stress_mode = argc > 1 && !strcmp (argv[1], "-stress");
+  const char * name = argv[stress_mode ? 2 : 1];
+
+  if (argc < (stress_mode ? 3 : 2))
+  {
+    fprintf (stderr, "usage: %s [-stress [seconds]] firmware.elf\n", argv[0]);
+    return 1;
+  }
+
+  uint32_t seconds = 5;
+
+  if (stress_mode && argc > 3)
+  {
+    seconds = atoi (argv[2]);
+    name = argv[3];
+  }
+
+  elf_firmware_t f;
+  memset (& f, 0, sizeof (f));
+
+  if (elf_read_firmware (name, & f))
+  {
+    fprintf (stderr, "bench: cannot read %s\n", name);
+    return 1;
+  }
+
+  bench.avr = avr_make_mcu_by_name ("atmega328p");
+  avr_init (bench.avr);
+  bench.avr->frequency = F_cpu;
+  avr_load_firmware (bench.avr, & f);
+
+  bench.rx = avr_io_getirq (bench.avr, AVR_IOCTL_UART_GETIRQ ('0'), UART_IRQ_INPUT);
+
+  for (uint8_t pin = 0; pin < 8; ++pin)
+  {
+    bench.portc[pin] = avr_io_getirq (bench.avr, AVR_IOCTL_IOPORT_GETIRQ ('C'), pin);
+  }
+
+  avr_irq_register_notify (avr_io_getirq (bench.avr, AVR_IOCTL_IOPORT_GETIRQ ('D'), Sid_cs), on_sid_cs, nullptr);
+
+  // Encoders rest with both contacts open and the switches released
+  for (uint8_t pin = Enc1_a; pin <= Sw1 + 1; ++pin)
+  {
+    set_pin (pin, 1);
+  }
+
+  run_for (200000);
+
+  return stress_mode ? stress (f, name, seconds) : hot_paths (f, name);
+}
@@ -0,0 +1,180 @@
+#ifndef _BENCH_H
+#define _BENCH_H
+
+// What the bench reads from the pins and the statistics it keeps, apart
+// from simavr so that test/bench_test.cc can check them on the host
+// against the firmware's own SID bus and encoder code.
+
+#include <stdint.h>
+#include <deque>
+#include <vector>
+
+// Probe names in the order of enum Probe in src/profile.h
+static const char * const probe_names[] =
+{
+  "note_on",
+  "sid_update",
+  "render",
+  "save",
+  "timer_isr",
+  "pcint_isr",
+  "uart_isr",
+  "eeprom_isr",
+};
+
+// Encoder contacts as (a << 1) | b for two detents each way, starting
+// from rest with both open (11). One detent is two quarter steps.
+static const uint8_t encoder_cw[]  = { 0x1, 0x0, 0x2, 0x3 };
+static const uint8_t encoder_ccw[] = { 0x2, 0x0, 0x1, 0x3 };
+
+struct Stats
+{
+  uint64_t min;
+  uint64_t max;
+  uint64_t sum;
+  uint32_t runs;
+
+  void add (uint64_t v)
+  {
+    if (runs == 0 || v < min)
+      min = v;
+
+    if (v > max)
+      max = v;
+
+    sum += v;
+    runs++;
+  }
+};
+
+// SID bus as seen on the pins: the 595s shift on the rising clock edge,
+// data byte first, and the chip takes the write when CS goes low. Pin
+// levels may be reported more than once; only changes count.
+struct Sid_bus
+{
+  Sid_bus ()
+    : data_pin (0)
+    , clock_pin (0)
+    , cs_pin (1)
+    , shift (0)
+  {
+  }
+
+  void data (uint32_t level)
+  {
+    data_pin = level & 1;
+  }
+
+  void clock (uint32_t level)
+  {
+    if (level && !clock_pin)
+      shift = shift << 1 | data_pin;
+
+    clock_pin = level & 1;
+  }
+
+  // True on the strobe, with the register written
+  bool select (uint32_t level, uint8_t & address, uint8_t & value)
+  {
+    bool strobe = !level && cs_pin;
+    cs_pin = level & 1;
+
+    if (!strobe)
+      return false;
+
+    address = shift & 0xff;
+    value = shift >> 8;
+    return true;
+  }
+
+  uint8_t  data_pin;
+  uint8_t  clock_pin;
+  uint8_t  cs_pin;
+  uint16_t shift;
+};
+
+static const uint8_t Freq_lo = 0;  // voice 1 frequency
+static const uint8_t Freq_hi = 1;
+
+// Latency from each note on reaching the UART to the write of its
+// frequency to voice 1. Notes are told apart by their frequency word: a
+// write completing a note's word serves it and every note received
+// before it that is still waiting, which were coalesced and never heard.
+// Only notes write the frequency, so a write that serves none is stray.
+// A low byte counts as one only when the high byte does not follow.
+struct Note_latency
+{
+  struct Pending
+  {
+    uint64_t rx;         // when the note on reached the UART
+    uint16_t frequency;
+  };
+
+  Note_latency ()
+    : frequency (0)
+    , coalesced (0)
+    , stray (0)
+    , low_only (false)
+  {
+  }
+
+  void note (uint64_t rx, uint16_t f)
+  {
+    pending.push_back ({ rx, f });
+  }
+
+  void write (uint8_t address, uint8_t data, uint64_t now)
+  {
+    if (address == Freq_lo)
+      frequency = (frequency & 0xff00) | data;
+
+    else if (address == Freq_hi)
+      frequency = (frequency & 0x00ff) | data << 8;
+
+    if (low_only && address != Freq_hi)
+      stray++;
+
+    low_only = false;
+
+    if (address != Freq_lo && address != Freq_hi)
+      return;
+
+    size_t served = 0;
+
+    for (size_t i = 0; i < pending.size () && pending[i].rx < now; ++i)
+    {
+      if (pending[i].frequency == frequency)
+        served = i + 1;
+    }
+
+    if (!served)
+    {
+      if (address == Freq_lo)
+        low_only = true;
+
+      else
+        stray++;
+
+      return;
+    }
+
+    latencies.push_back (now - pending[served - 1].rx);
+    coalesced += served - 1;
+    pending.erase (pending.begin (), pending.begin () + served);
+  }
+
+  std::deque<Pending>   pending;
+  std::vector<uint64_t> latencies;
+  uint16_t              frequency;
+  uint32_t              coalesced;
+  uint32_t              stray;
+  bool                  low_only;
+};
+
+// Nearest rank, rounding down, of sorted samples; 0 without samples
+static uint64_t percentile (const std::vector<uint64_t> & sorted, uint8_t p)
+{
+  return sorted.empty () ? 0 : sorted[(sorted.size () - 1) * p / 100];
+}
+
+#endif /* _BENCH_H */
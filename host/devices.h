@@ -0,0 +1,81 @@
+#ifndef _HOST_DEVICES_H
+#define _HOST_DEVICES_H
+
+// Devices for building the firmware classes on the host. They stand in for
+// the SID shift register, the OLED SPI port and the MIDI UART.
+
+#include <stdint.h>
+#include "sid.h"
+
+// Simulated time in microseconds, advanced by whoever drives the devices.
+// Per thread, so batch renders can run side by side.
+thread_local uint32_t _host_time;
+
+namespace host
+{
+
+// Keeps the register file the SID would see and counts bus writes
+struct Sid_registers
+{
+  static void write (uint8_t address, uint8_t data)
+  {
+    registers[address] = data;
+    writes++;
+  }
+
+  static uint8_t  registers[Last_register];
+  static uint32_t writes;
+};
+
+uint8_t  Sid_registers::registers[Last_register];
+uint32_t Sid_registers::writes;
+
+// Accepts and drops display traffic
+struct Null_oled
+{
+  static void command (uint8_t command)
+  {
+  }
+
+  static void data (uint8_t data)
+  {
+  }
+};
+
+// MIDI input fed from a byte array instead of the UART interrupt
+class Serial
+{
+  public:
+    Serial ()
+      : _data (nullptr)
+      , _length (0)
+      , _pos (0)
+    {
+    }
+
+    void feed (const uint8_t * data, uint32_t length)
+    {
+      _data = data;
+      _length = length;
+      _pos = 0;
+    }
+
+    bool available ()
+    {
+      return _pos < _length;
+    }
+
+    uint8_t receive ()
+    {
+      return _data[_pos++];
+    }
+
+  private:
+    const uint8_t * _data;
+    uint32_t        _length;
+    uint32_t        _pos;
+};
+
+}
+
+#endif /* _HOST_DEVICES_H */
@@ -0,0 +1,305 @@
+// Fuzz target for the MIDI parser and handler chain. Arbitrary bytes go
+// through Midi<> into a callback that checks every message before handing
+// it to the firmware's Engine, whose Sid<> shadow writes into a device that
+// checks the register addresses. Frames and EEPROM writes run between the
+// bytes as they would at 31250 baud.
+//
+// Built with clang and -fsanitize=fuzzer this is a libFuzzer target. With
+// FUZZ_STANDALONE it gets its own main, for compilers without libFuzzer:
+//
+//   fuzz_midi [-runs=N] [-seed=N] file|dir ...
+//
+// runs every input once, then, if -runs is given, N inputs made by
+// randomly mutating them.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "synth.h"
+
+#define FUZZ_CHECK(cond) \
+  do { if (!(cond)) { fprintf (stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); abort (); } } while (0)
+
+struct Checked_device
+{
+  static void write (uint8_t address, uint8_t data)
+  {
+    FUZZ_CHECK (address < Last_register);
+  }
+};
+
+using Synth = host::Synth<Checked_device>;
+
+struct Checker
+{
+  static void note_on (uint8_t channel, uint8_t note, uint8_t velocity)
+  {
+    FUZZ_CHECK (channel < 16);
+    FUZZ_CHECK (note < 128);
+    FUZZ_CHECK (velocity > 0 && velocity < 128);
+    Synth::note_on (channel, note, velocity);
+  }
+
+  static void note_off (uint8_t channel)
+  {
+    FUZZ_CHECK (channel < 16);
+    Synth::note_off (channel);
+  }
+
+  static void pressure (uint8_t channel, uint8_t value)
+  {
+    FUZZ_CHECK (channel < 16);
+    FUZZ_CHECK (value < 128);
+    Synth::pressure (channel, value);
+  }
+
+  static void program_change (uint8_t channel, uint8_t program)
+  {
+    FUZZ_CHECK (channel < 16);
+    FUZZ_CHECK (program < 128);
+    Synth::program_change (channel, program);
+  }
+
+  static void control_change (uint8_t channel, uint8_t control, uint8_t value)
+  {
+    FUZZ_CHECK (channel < 16);
+    FUZZ_CHECK (control < 128);
+    FUZZ_CHECK (value < 128);
+    Synth::control_change (channel, control, value);
+
+    // Scaled controller values stay in each parameter's range
+    for (uint8_t setting = 0; setting < Num_settings; ++setting)
+    {
+      auto p = get_parameter (setting);
+
+      for (uint8_t voice = 0; voice < get_voices (p); ++voice)
+        FUZZ_CHECK (Synth::settings.get (static_cast<Setting> (setting), voice) <= p.max);
+    }
+  }
+
+  static void pitch_bend (uint8_t channel, int32_t value)
+  {
+    FUZZ_CHECK (channel < 16);
+    FUZZ_CHECK (value >= 0 && value < 0x4000);
+    Synth::pitch_bend (channel, value);
+  }
+
+  // Counts up through the beat, from 0 after a start
+  static void clock (uint8_t counter)
+  {
+    FUZZ_CHECK (counter < 24);
+    FUZZ_CHECK (counter == 0 || counter == last_clock + 1);
+    last_clock = counter;
+    Synth::clock (counter);
+  }
+
+  // Exclusive payload only ever comes between a start and an end
+  static void sysex_start ()
+  {
+    FUZZ_CHECK (!in_sysex);
+    in_sysex = true;
+    Synth::sysex_start ();
+  }
+
+  static void sysex_data (uint8_t data)
+  {
+    FUZZ_CHECK (in_sysex);
+    FUZZ_CHECK (data < 0x80);
+    Synth::sysex_data (data);
+  }
+
+  static void sysex_end (bool complete)
+  {
+    FUZZ_CHECK (in_sysex);
+    in_sysex = false;
+    Synth::sysex_end (complete);
+  }
+
+  static bool    in_sysex;
+  static uint8_t last_clock;
+};
+
+bool    Checker::in_sysex;
+uint8_t Checker::last_clock;
+
+extern "C" int LLVMFuzzerTestOneInput (const uint8_t * data, size_t size)
+{
+  host::Serial serial;
+  Midi<Checker, host::Serial> midi (serial);
+
+  Synth::init ();
+  Checker::in_sysex = false;
+  Checker::last_clock = 0;
+
+  for (size_t i = 0; i < size; ++i)
+  {
+    Synth::run_until (_host_time + host::Midi_us_per_byte);
+    serial.feed (data + i, 1);
+    midi.process_next ();
+  }
+
+  Synth::run_until (_host_time + host::Frame_us);
+  return 0;
+}
+
+#ifdef FUZZ_STANDALONE
+
+#include <dirent.h>
+#include <sys/stat.h>
+#include <string>
+#include <vector>
+
+using Input = std::vector<uint8_t>;
+
+static bool load (const char * path, Input & input)
+{
+  FILE * f = fopen (path, "rb");
+
+  if (!f)
+    return false;
+
+  input.clear ();
+  int c;
+
+  while ((c = fgetc (f)) != EOF)
+  {
+    input.push_back (c);
+  }
+
+  fclose (f);
+  return true;
+}
+
+static void collect (const char * path, std::vector<Input> & inputs)
+{
+  struct stat st;
+
+  if (stat (path, & st))
+  {
+    fprintf (stderr, "fuzz_midi: cannot open %s\n", path);
+    return;
+  }
+
+  if (S_ISDIR (st.st_mode))
+  {
+    DIR * dir = opendir (path);
+    dirent * e;
+
+    while (dir && (e = readdir (dir)))
+    {
+      if (e->d_name[0] != '.')
+        collect ((std::string (path) + "/" + e->d_name).c_str (), inputs);
+    }
+
+    if (dir)
+      closedir (dir);
+
+    return;
+  }
+
+  Input input;
+
+  if (load (path, input))
+    inputs.push_back (input);
+}
+
+// Byte flips, interesting values, insertions, deletions and splices
+static void mutate (Input & input, const std::vector<Input> & pool)
+{
+  static const uint8_t interesting[] = { 0x00, 0x7f, 0x80, 0x90, 0xb0, 0xc0, 0xe0, 0xf0, 0xf7, 0xf8, 0xfa, 0xfe, 0xff };
+  uint8_t count = 1 + rand () % 8;
+
+  for (uint8_t i = 0; i < count; ++i)
+  {
+    size_t pos = input.empty () ? 0 : rand () % input.size ();
+
+    switch (rand () % 5)
+    {
+      case 0:
+        if (!input.empty ())
+          input[pos] ^= 1 << (rand () % 8);
+        break;
+
+      case 1:
+        if (!input.empty ())
+          input[pos] = interesting[rand () % sizeof (interesting)];
+        break;
+
+      case 2:
+        input.insert (input.begin () + pos, rand () & 0xff);
+        break;
+
+      case 3:
+        if (!input.empty ())
+          input.erase (input.begin () + pos);
+        break;
+
+      case 4:
+      {
+        auto & other = pool[rand () % pool.size ()];
+
+        if (!other.empty ())
+        {
+          size_t from = rand () % other.size ();
+          size_t n = 1 + rand () % (other.size () - from);
+          input.insert (input.begin () + pos, other.begin () + from, other.begin () + from + n);
+        }
+
+        break;
+      }
+    }
+  }
+}
+
+int main (int argc, char * argv[])
+{
+  unsigned long runs = 0;
+  unsigned seed = 1;
+  std::vector<Input> inputs;
+
+  for (int i = 1; i < argc; ++i)
+  {
+    if (!strncmp (argv[i], "-runs=", 6))
+      runs = strtoul (argv[i] + 6, nullptr, 10);
+    else if (!strncmp (argv[i], "-seed=", 6))
+      seed = strtoul (argv[i] + 6, nullptr, 10);
+    else
+      collect (argv[i], inputs);
+  }
+
+  if (inputs.empty ())
+  {
+    Input input;
+    int c;
+
+    while ((c = getchar ()) != EOF)
+    {
+      input.push_back (c);
+    }
+
+    inputs.push_back (input);
+  }
+
+  for (auto & input : inputs)
+  {
+    LLVMFuzzerTestOneInput (input.data (), input.size ());
+  }
+
+  srand (seed);
+
+  for (unsigned long run = 0; run < runs; ++run)
+  {
+    Input input = inputs[rand () % inputs.size ()];
+    mutate (input, inputs);
+
+    if (input.size () > 4096)
+      input.resize (4096);
+
+    LLVMFuzzerTestOneInput (input.data (), input.size ());
+  }
+
+  printf ("fuzz_midi: %u inputs, %lu mutated runs\n", (unsigned) inputs.size (), runs);
+  return 0;
+}
+
+#endif /* FUZZ_STANDALONE */
@@ -0,0 +1,101 @@
+// Native build of the synth core. Sid, Midi, RingBuffer, Menu, Settings
+// and Ui are compiled for the workstation against the mock AVR headers in
+// host/include, with the devices from devices.h injected in place of the
+// hardware. Raw MIDI bytes are read from stdin and the resulting SID
+// register file is printed once the input is consumed.
+
+#include <stdio.h>
+#include <vector>
+#include "synth.h"
+#include "menu.h"
+#include "oled.h"
+#include "ui.h"
+
+namespace strings
+{
+  const char mark  [] PROGMEM = ">";
+  const char voice [] PROGMEM = "VOICE";
+}
+
+using Synth = host::Synth<host::Sid_registers>;
+
+Oled<host::Null_oled> _oled;
+Settings &            _settings = Synth::settings;
+auto &                _sid = Synth::sid;
+
+void render_item (uint8_t x, uint8_t y, const char * text, const char * val, bool current)
+{
+}
+
+const char * read_setting (uint8_t setting, uint8_t voice, char * val)
+{
+  itoa (_settings.get (static_cast<Setting> (setting), voice), val, 10);
+  return get_parameter (setting).label;
+}
+
+void write_setting (uint8_t setting, uint8_t voice, int8_t val)
+{
+  auto s = static_cast<Setting> (setting);
+  auto p = get_parameter (setting);
+
+  int16_t v = _settings.get (s, voice) + val;
+  _settings.set (s, voice, v < 0 ? 0 : v > p.max ? p.max : v);
+  apply_parameter (_sid, p, voice, _settings.get (s, voice));
+}
+
+uint8_t range_setting (uint8_t setting)
+{
+  return get_parameter (setting).max;
+}
+
+const uint8_t voice_items[] PROGMEM =
+{
+  VOICE_FREQUENCY,
+  VOICE_SHAPE,
+  VOICE_PW,
+  VOICE_ATTACK,
+  VOICE_DECAY,
+  VOICE_SUSTAIN,
+  VOICE_RELEASE,
+};
+
+const MenuPage menu_pages[] PROGMEM =
+{
+  make_page (strings::voice, voice_items, _1),
+};
+
+Menu _menu (menu_pages, & render_item, & read_setting, & write_setting, & range_setting, strings::mark);
+Encoder _e1 (DDRC, PORTC, PINC, PCMSK1, PC0, PC1, PC4);
+Encoder _e2 (DDRC, PORTC, PINC, PCMSK1, PC2, PC3, PC5);
+Ui<decltype (_oled)> _ui (_e1, _e2, _menu, _oled, _settings);
+
+int main ()
+{
+  std::vector<uint8_t> input;
+  int c;
+
+  while ((c = getchar ()) != EOF)
+  {
+    input.push_back (c);
+  }
+
+  Synth::init ();
+
+  _e1.init ();
+  _e2.init ();
+  _ui.render ();
+
+  host::play<host::Sid_registers> (input.data (), input.size ());
+
+  _ui.update ();
+  _ui.render ();
+
+  printf ("%u bytes, %u register writes\n", (unsigned) input.size (), host::Sid_registers::writes);
+
+  for (uint8_t reg = 0; reg < Last_register; ++reg)
+  {
+    printf ("%02x %02x\n", reg, host::Sid_registers::registers[reg]);
+  }
+
+  return 0;
+}
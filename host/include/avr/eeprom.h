@@ -0,0 +1,39 @@
+#ifndef _HOST_AVR_EEPROM_H
+#define _HOST_AVR_EEPROM_H
+
+// EEMEM variables are ordinary globals on the host, so the EEPROM access
+// functions read and write them directly. They are per thread, like the
+// EEPROM registers, so batch renders each have their own bank.
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+#define EEMEM thread_local
+
+inline uint8_t eeprom_read_byte (const uint8_t * p)
+{
+  return * p;
+}
+
+inline void eeprom_read_block (void * dst, const void * src, size_t n)
+{
+  memcpy (dst, src, n);
+}
+
+inline void eeprom_write_byte (uint8_t * p, uint8_t value)
+{
+  * p = value;
+}
+
+inline void eeprom_update_byte (uint8_t * p, uint8_t value)
+{
+  * p = value;
+}
+
+inline void eeprom_update_block (const void * src, void * dst, size_t n)
+{
+  memcpy (dst, src, n);
+}
+
+#endif /* _HOST_AVR_EEPROM_H */
@@ -0,0 +1,12 @@
+#ifndef _HOST_AVR_INTERRUPT_H
+#define _HOST_AVR_INTERRUPT_H
+
+// Interrupt handlers become plain functions named after their vector, so
+// host code raises an interrupt by calling e.g. USART_RX_vect ().
+
+#define ISR(vector) inline void vector ()
+
+inline void sei () {}
+inline void cli () {}
+
+#endif /* _HOST_AVR_INTERRUPT_H */
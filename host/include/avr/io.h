@@ -0,0 +1,209 @@
+#ifndef _HOST_AVR_IO_H
+#define _HOST_AVR_IO_H
+
+// Host stand-in for the ATmega328P register file. Each register is a
+// plain variable that tests can poke and inspect.
+
+#include <stdint.h>
+
+#define _BV(bit) (1 << (bit))
+
+namespace mock
+{
+  template<int Address, typename T = uint8_t>
+  struct Io
+  {
+    static volatile T value;
+  };
+
+  template<int Address, typename T>
+  volatile T Io<Address, T>::value = 0;
+
+  // Output port whose writes can be watched, so that a bus the firmware
+  // bit bangs can be decoded from the pins as they change
+  struct Port
+  {
+    Port & operator= (uint8_t v)
+    {
+      value = v;
+
+      if (watch)
+        watch (v);
+
+      return * this;
+    }
+
+    Port & operator|= (uint8_t v) { return * this = value | v; }
+    Port & operator&= (uint8_t v) { return * this = value & v; }
+    operator uint8_t () const { return value; }
+
+    uint8_t value;
+    void (* watch) (uint8_t value);
+  };
+
+  template<int Address>
+  struct Output
+  {
+    static Port value;
+  };
+
+  template<int Address>
+  Port Output<Address>::value {};
+
+  // EEPROM control register. Strobing EERE or EEPE moves a byte between
+  // EEDR and the EEMEM variable EEAR points at, which on the host is an
+  // ordinary global, so EEAR is as wide as a pointer. Writes complete
+  // immediately and are counted for wear checks.
+  struct Eeprom_control
+  {
+    Eeprom_control & operator= (uint8_t v);
+    Eeprom_control & operator|= (uint8_t v) { return * this = bits | v; }
+    Eeprom_control & operator&= (uint8_t v) { return * this = bits & v; }
+    operator uint8_t () const { return bits; }
+
+    uint8_t bits;
+  };
+
+  template<typename T = void>
+  struct Eeprom
+  {
+    static thread_local Eeprom_control control;
+    static thread_local uintptr_t      address;
+    static thread_local uint8_t        data;
+    static thread_local uint32_t       writes;
+  };
+
+  template<typename T> thread_local Eeprom_control Eeprom<T>::control {};
+  template<typename T> thread_local uintptr_t      Eeprom<T>::address = 0;
+  template<typename T> thread_local uint8_t        Eeprom<T>::data = 0;
+  template<typename T> thread_local uint32_t       Eeprom<T>::writes = 0;
+}
+
+#define PINB   (mock::Io<0x23>::value)
+#define DDRB   (mock::Io<0x24>::value)
+#define PORTB  (mock::Io<0x25>::value)
+#define PINC   (mock::Io<0x26>::value)
+#define DDRC   (mock::Io<0x27>::value)
+#define PORTC  (mock::Io<0x28>::value)
+#define PIND   (mock::Io<0x29>::value)
+#define DDRD   (mock::Io<0x2a>::value)
+#define PORTD  (mock::Output<0x2b>::value)
+#define TIFR0  (mock::Io<0x35>::value)
+#define TIFR2  (mock::Io<0x37>::value)
+#define TCCR0A (mock::Io<0x44>::value)
+#define TCCR0B (mock::Io<0x45>::value)
+#define TCNT0  (mock::Io<0x46>::value)
+#define OCR0A  (mock::Io<0x47>::value)
+#define SPCR   (mock::Io<0x4c>::value)
+#define SPSR   (mock::Io<0x4d>::value)
+#define SPDR   (mock::Io<0x4e>::value)
+#define PCICR  (mock::Io<0x68>::value)
+#define PCMSK1 (mock::Io<0x6c>::value)
+#define TIMSK0 (mock::Io<0x6e>::value)
+#define TIMSK2 (mock::Io<0x70>::value)
+#define TCCR1A (mock::Io<0x80>::value)
+#define TCCR1B (mock::Io<0x81>::value)
+#define OCR1A  (mock::Io<0x88, uint16_t>::value)
+#define TCCR2A (mock::Io<0xb0>::value)
+#define TCCR2B (mock::Io<0xb1>::value)
+#define TCNT2  (mock::Io<0xb2>::value)
+#define UCSR0A (mock::Io<0xc0>::value)
+#define UCSR0B (mock::Io<0xc1>::value)
+#define UCSR0C (mock::Io<0xc2>::value)
+#define UBRR0  (mock::Io<0xc4, uint16_t>::value)
+#define UDR0   (mock::Io<0xc6>::value)
+
+#define EECR   (mock::Eeprom<>::control)
+#define EEDR   (mock::Eeprom<>::data)
+#define EEAR   (mock::Eeprom<>::address)
+
+inline mock::Eeprom_control & mock::Eeprom_control::operator= (uint8_t v)
+{
+  bits = v;
+
+  if (bits & _BV (0))
+  {
+    EEDR = * (const uint8_t *) EEAR;
+  }
+
+  if (bits & _BV (1))
+  {
+    * (uint8_t *) EEAR = EEDR;
+    mock::Eeprom<>::writes++;
+  }
+
+  bits &= ~ (_BV (0) | _BV (1) | _BV (2));
+  return * this;
+}
+
+// bit::set and bit::clear of avr_types.h for watched ports
+namespace bit
+{
+  inline void set (mock::Port & port, uint8_t bit)
+  {
+    port |= _BV (bit);
+  }
+
+  inline void clear (mock::Port & port, uint8_t bit)
+  {
+    port &= ~ _BV (bit);
+  }
+}
+
+#define PB0 0
+#define PB1 1
+#define PB2 2
+#define PB3 3
+#define PB4 4
+#define PB5 5
+
+#define PC0 0
+#define PC1 1
+#define PC2 2
+#define PC3 3
+#define PC4 4
+#define PC5 5
+
+#define PD0 0
+#define PD1 1
+#define PD2 2
+#define PD3 3
+#define PD4 4
+#define PD5 5
+#define PD6 6
+#define PD7 7
+
+#define PCIE1 1
+
+#define EERE   0
+#define EEPE   1
+#define EEMPE  2
+#define EERIE  3
+
+#define SPI2X  0
+#define SPIF   7
+#define MSTR   4
+#define SPE    6
+
+#define OCF0A  1
+#define OCIE0A 1
+#define WGM01  1
+#define CS00   0
+#define CS01   1
+#define CS02   2
+
+#define CS10   0
+#define WGM12  3
+#define COM1A0 6
+
+#define TOV2   0
+#define TOIE2  0
+#define CS21   1
+
+#define DOR0   3
+#define UCSZ00 1
+#define UCSZ01 2
+#define RXEN0  4
+#define RXCIE0 7
+
+#endif /* _HOST_AVR_IO_H */
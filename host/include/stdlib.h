@@ -0,0 +1,23 @@
+#ifndef _HOST_STDLIB_H
+#define _HOST_STDLIB_H
+
+// Adds the avr-libc number formatting functions missing from the host libc.
+// int is 16 bits on the AVR, so values are truncated the same way.
+
+#include_next <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+
+inline char * itoa (int value, char * s, int radix)
+{
+  snprintf (s, 8, radix == 16 ? "%x" : "%d", (int16_t) value);
+  return s;
+}
+
+inline char * utoa (unsigned value, char * s, int radix)
+{
+  snprintf (s, 8, radix == 16 ? "%x" : "%u", (uint16_t) value);
+  return s;
+}
+
+#endif /* _HOST_STDLIB_H */
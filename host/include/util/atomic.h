@@ -0,0 +1,12 @@
+#ifndef _HOST_UTIL_ATOMIC_H
+#define _HOST_UTIL_ATOMIC_H
+
+// Host code is single threaded and interrupts are called synchronously,
+// so an atomic block runs its body once.
+
+#define ATOMIC_RESTORESTATE 0
+#define ATOMIC_FORCEON      0
+
+#define ATOMIC_BLOCK(type) for (bool _atomic_once = true; _atomic_once; _atomic_once = false)
+
+#endif /* _HOST_UTIL_ATOMIC_H */
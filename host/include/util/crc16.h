@@ -0,0 +1,22 @@
+#ifndef _HOST_UTIL_CRC16_H
+#define _HOST_UTIL_CRC16_H
+
+#include <stdint.h>
+
+// C equivalent of the avr-libc routine (CRC-16, polynomial 0xa001)
+inline uint16_t _crc16_update (uint16_t crc, uint8_t a)
+{
+  crc ^= a;
+
+  for (uint8_t i = 0; i < 8; ++i)
+  {
+    if (crc & 1)
+      crc = (crc >> 1) ^ 0xa001;
+    else
+      crc = (crc >> 1);
+  }
+
+  return crc;
+}
+
+#endif /* _HOST_UTIL_CRC16_H */
@@ -0,0 +1,7 @@
+#ifndef _HOST_UTIL_DELAY_H
+#define _HOST_UTIL_DELAY_H
+
+inline void _delay_ms (double) {}
+inline void _delay_us (double) {}
+
+#endif /* _HOST_UTIL_DELAY_H */
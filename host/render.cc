@@ -0,0 +1,191 @@
+// Offline renderer. Plays a standard MIDI file through Midi<> and the
+// firmware's Engine, frame tasks included, into the SID emulator and
+// writes a WAV file.
+//
+//   render [-8580] [-r rate] in.mid out.wav
+//   render [-8580] [-r rate] -j threads -o dir a.mid b.mid ...
+//
+// The second form renders a corpus, one file per worker at a time, and
+// names the output after each input. Render speed is reported on stderr
+// as a multiple of real time.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+#include "synth.h"
+#include "sid_emulator.h"
+#include "smf.h"
+#include "wav.h"
+
+using Synth = host::Synth<host::Emulator_device>;
+
+static constexpr uint32_t Tail_us = 2000000;
+
+struct Options
+{
+  host::Sid_emulator::Model model = host::Sid_emulator::Mos6581;
+  uint32_t                  rate = 44100;
+};
+
+static bool render (const Options & options, const char * in, const char * out)
+{
+  std::vector<host::Midi_event> events;
+  host::Smf_reader reader;
+
+  if (!reader.read (in, events))
+  {
+    fprintf (stderr, "render: cannot read %s\n", in);
+    return false;
+  }
+
+  auto start = std::chrono::steady_clock::now ();
+
+  host::Sid_emulator emulator (options.model);
+  host::Emulator_device::emulator = & emulator;
+  Synth::init ();
+
+  host::Serial serial;
+  Midi<Synth, host::Serial> midi (serial);
+
+  std::vector<int16_t> samples;
+  uint64_t end = (events.empty () ? 0 : events.back ().time) + Tail_us;
+  samples.reserve (end * options.rate / 1000000 + 1);
+
+  auto render_to = [&] (uint64_t time)
+  {
+    size_t target = time * options.rate / 1000000;
+
+    if (target > samples.size ())
+    {
+      size_t n = samples.size ();
+      samples.resize (target);
+      emulator.render (samples.data () + n, target - n, options.rate);
+    }
+  };
+
+  // Frames write registers between events, so the audio is rendered up
+  // to each of them before it runs
+  auto run_to = [&] (uint32_t time)
+  {
+    while (Synth::next () <= time)
+    {
+      render_to (Synth::next ());
+      Synth::step ();
+    }
+
+    render_to (time);
+    Synth::run_until (time);
+  };
+
+  for (auto & e : events)
+  {
+    run_to (e.time);
+    serial.feed (e.data, e.length);
+
+    while (serial.available ())
+    {
+      midi.process_next ();
+    }
+  }
+
+  run_to (end);
+
+  if (!host::write_wav (out, samples, options.rate))
+  {
+    fprintf (stderr, "render: cannot write %s\n", out);
+    return false;
+  }
+
+  std::chrono::duration<double> took = std::chrono::steady_clock::now () - start;
+  fprintf (stderr, "%s: %.1f s audio in %.2f s (%.0fx real time)\n",
+           out, end / 1e6, took.count (), end / 1e6 / took.count ());
+
+  return true;
+}
+
+static std::string output_path (const char * dir, const char * in)
+{
+  std::string name = in;
+  auto slash = name.find_last_of ('/');
+
+  if (slash != std::string::npos)
+    name = name.substr (slash + 1);
+
+  auto dot = name.find_last_of ('.');
+
+  if (dot != std::string::npos)
+    name = name.substr (0, dot);
+
+  return std::string (dir) + "/" + name + ".wav";
+}
+
+static int usage (const char * name)
+{
+  fprintf (stderr, "usage: %s [-8580] [-r rate] in.mid out.wav\n", name);
+  fprintf (stderr, "       %s [-8580] [-r rate] -j threads -o dir in.mid ...\n", name);
+  return 2;
+}
+
+int main (int argc, char * argv[])
+{
+  Options options;
+  unsigned threads = 0;
+  const char * dir = nullptr;
+  int i = 1;
+
+  for (; i < argc && argv[i][0] == '-'; ++i)
+  {
+    if (!strcmp (argv[i], "-8580"))
+      options.model = host::Sid_emulator::Mos8580;
+    else if (!strcmp (argv[i], "-r") && i + 1 < argc)
+      options.rate = atoi (argv[++i]);
+    else if (!strcmp (argv[i], "-j") && i + 1 < argc)
+      threads = atoi (argv[++i]);
+    else if (!strcmp (argv[i], "-o") && i + 1 < argc)
+      dir = argv[++i];
+    else
+      return usage (argv[0]);
+  }
+
+  if (options.rate < 8000 || options.rate > 192000)
+    return usage (argv[0]);
+
+  if (!threads)
+  {
+    if (argc - i != 2)
+      return usage (argv[0]);
+
+    return render (options, argv[i], argv[i + 1]) ? 0 : 1;
+  }
+
+  if (!dir || i == argc)
+    return usage (argv[0]);
+
+  std::atomic<int>  next (i);
+  std::atomic<bool> failed (false);
+  std::vector<std::thread> workers;
+
+  for (unsigned t = 0; t < threads; ++t)
+  {
+    workers.emplace_back ([&]
+    {
+      for (int n = next++; n < argc; n = next++)
+      {
+        if (!render (options, argv[n], output_path (dir, argv[n]).c_str ()))
+          failed = true;
+      }
+    });
+  }
+
+  for (auto & w : workers)
+  {
+    w.join ();
+  }
+
+  return failed ? 1 : 0;
+}
@@ -0,0 +1,56 @@
+// Replays a register write trace. With one trace the writes are played
+// into a register file, which is printed with the write count. With two
+// the second is checked against the first as the golden tests do, and the
+// exit status says whether they agree.
+
+#include <stdio.h>
+#include "trace.h"
+
+int main (int argc, char * argv[])
+{
+  if (argc < 2 || argc > 3)
+  {
+    fprintf (stderr, "usage: %s trace [reference]\n", argv[0]);
+    return 2;
+  }
+
+  host::Trace trace;
+
+  if (!host::read_trace (argv[1], trace))
+  {
+    fprintf (stderr, "replay: cannot read %s\n", argv[1]);
+    return 2;
+  }
+
+  if (argc == 2)
+  {
+    host::replay<host::Sid_registers> (trace);
+    printf ("%u writes, %u us\n", (unsigned) trace.size (), _host_time);
+
+    for (uint8_t reg = 0; reg < Last_register; ++reg)
+    {
+      printf ("%02x %02x\n", reg, host::Sid_registers::registers[reg]);
+    }
+
+    return 0;
+  }
+
+  host::Trace reference;
+
+  if (!host::read_trace (argv[2], reference))
+  {
+    fprintf (stderr, "replay: cannot read %s\n", argv[2]);
+    return 2;
+  }
+
+  auto r = host::compare (reference, trace);
+
+  if (!r.match)
+  {
+    printf ("differs at %u us, register %02x\n", r.time, r.address);
+    return 1;
+  }
+
+  printf ("match, %u writes (reference %u)\n", r.actual, r.expected);
+  return 0;
+}
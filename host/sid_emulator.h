@@ -0,0 +1,422 @@
+#ifndef _HOST_SID_EMULATOR_H
+#define _HOST_SID_EMULATOR_H
+
+// Cycle stepped model of the SID for rendering on the host. Oscillators,
+// noise and envelopes follow the chip: 24 bit phase accumulators, the 23
+// bit noise LFSR and the envelope generator with its real rate counter
+// periods and piecewise exponential decay. The filter is a two integrator
+// state variable filter with approximate cutoff curves for the 6581 and
+// the 8580; it is not a circuit model. Combined waveforms are the AND of
+// their parts.
+
+#include <stdint.h>
+#include <math.h>
+#include "sid.h"
+
+namespace host
+{
+
+// Envelope rate counter periods in chip cycles, per 4 bit rate value
+static const uint16_t envelope_periods[16] =
+{
+  9, 32, 63, 95, 149, 220, 267, 313, 392, 977, 1954, 3126, 3907, 11720, 19532, 31251,
+};
+
+static constexpr uint8_t Registers_per_voice = Voice_2_freq_lo - Voice_1_freq_lo;
+
+class Sid_emulator
+{
+  enum State
+  {
+    Attack,
+    Decay_sustain,
+    Release,
+  };
+
+  struct Voice
+  {
+    uint32_t acc;
+    uint32_t noise;
+    uint16_t freq;
+    uint16_t pw;
+    uint8_t  control;
+    uint8_t  attack_decay;
+    uint8_t  sustain_release;
+
+    State    state;
+    uint8_t  envelope;
+    uint16_t rate_counter;
+    uint8_t  exponential_counter;
+    uint8_t  exponential_period;
+    bool     msb_rising;
+  };
+
+  public:
+    enum Model
+    {
+      Mos6581,
+      Mos8580,
+    };
+
+    static constexpr uint32_t Clock_rate = 1000000;
+
+    explicit Sid_emulator (Model model = Mos6581)
+      : _model (model)
+      , _cutoff (0)
+      , _res_filt (0)
+      , _mode_vol (0)
+      , _lp (0)
+      , _bp (0)
+      , _w0 (0)
+      , _q_inv (1.0f / 0.707f)
+      , _dc (0)
+      , _phase (0)
+    {
+      for (auto & v : _voices)
+      {
+        v = Voice {};
+        v.noise = 0x7ffff8;
+        v.state = Release;
+        v.exponential_period = 1;
+      }
+
+      update_filter ();
+    }
+
+    void write (uint8_t address, uint8_t value)
+    {
+      if (address >= Filter_cutoff_lo)
+      {
+        switch (address)
+        {
+          case Filter_cutoff_lo:
+            _cutoff = (_cutoff & 0x7f8) | (value & 0x07);
+            break;
+
+          case Filter_cutoff_hi:
+            _cutoff = (_cutoff & 0x007) | value << 3;
+            break;
+
+          case Filter_res_en:
+            _res_filt = value;
+            break;
+
+          case Filter_mode_vol:
+            _mode_vol = value;
+            break;
+
+          default:
+            return;
+        }
+
+        update_filter ();
+        return;
+      }
+
+      auto & v = _voices[address / Registers_per_voice];
+
+      switch (address % Registers_per_voice)
+      {
+        case Voice_1_freq_lo:
+          v.freq = (v.freq & 0xff00) | value;
+          break;
+
+        case Voice_1_freq_hi:
+          v.freq = (v.freq & 0x00ff) | value << 8;
+          break;
+
+        case Voice_1_pw_lo:
+          v.pw = (v.pw & 0xf00) | value;
+          break;
+
+        case Voice_1_pw_hi:
+          v.pw = (v.pw & 0x0ff) | (value & 0x0f) << 8;
+          break;
+
+        case Voice_1_control:
+          if ((value & Gate_bit) && !(v.control & Gate_bit))
+          {
+            v.state = Attack;
+          }
+
+          else if (!(value & Gate_bit) && (v.control & Gate_bit))
+          {
+            v.state = Release;
+          }
+
+          v.control = value;
+          break;
+
+        case Voice_1_ad:
+          v.attack_decay = value;
+          break;
+
+        case Voice_1_sr:
+          v.sustain_release = value;
+          break;
+      }
+    }
+
+    // Advances the chip by one cycle and returns the mixed output
+    int32_t clock ()
+    {
+      for (auto & v : _voices)
+      {
+        clock_oscillator (v);
+        clock_envelope (v);
+      }
+
+      // Hard sync resets a voice when its sync source wraps
+      for (uint8_t i = 0; i < 3; ++i)
+      {
+        auto & v = _voices[i];
+
+        if ((v.control & Sync_bit) && _voices[(i + 2) % 3].msb_rising)
+          v.acc = 0;
+      }
+
+      return mix ();
+    }
+
+    // Renders samples at the given rate. Each sample is the average of the
+    // chip cycles it covers, which doubles as a simple anti-alias filter.
+    void render (int16_t * out, uint32_t count, uint32_t rate)
+    {
+      for (uint32_t i = 0; i < count; ++i)
+      {
+        int64_t  sum = 0;
+        uint32_t cycles = 0;
+
+        for (_phase += Clock_rate; _phase >= rate; _phase -= rate)
+        {
+          sum += clock ();
+          cycles++;
+        }
+
+        float s = cycles ? (float) sum / cycles : 0;
+
+        // DC blocker in place of the output coupling capacitor
+        _dc += (s - _dc) * 0.0005f;
+        s -= _dc;
+
+        int32_t v = (int32_t) (s / 48);
+        out[i] = v < -32768 ? -32768 : v > 32767 ? 32767 : v;
+      }
+    }
+
+    uint8_t envelope (uint8_t voice) const
+    {
+      return _voices[voice].envelope;
+    }
+
+  private:
+
+    void clock_oscillator (Voice & v)
+    {
+      uint32_t prev = v.acc;
+
+      if (v.control & _BV (3))
+      {
+        v.acc = 0;
+        v.msb_rising = false;
+        return;
+      }
+
+      v.acc = (v.acc + v.freq) & 0xffffff;
+      v.msb_rising = !(prev & 0x800000) && (v.acc & 0x800000);
+
+      // Noise is shifted when bit 19 goes high
+      if (!(prev & 0x080000) && (v.acc & 0x080000))
+      {
+        uint32_t bit = ((v.noise >> 22) ^ (v.noise >> 17)) & 1;
+        v.noise = ((v.noise << 1) | bit) & 0x7fffff;
+      }
+    }
+
+    void clock_envelope (Voice & v)
+    {
+      uint8_t rate;
+
+      switch (v.state)
+      {
+        case Attack:
+          rate = v.attack_decay >> 4;
+          break;
+
+        case Decay_sustain:
+          rate = v.attack_decay & 0x0f;
+          break;
+
+        default:
+          rate = v.sustain_release & 0x0f;
+          break;
+      }
+
+      if (++v.rate_counter < envelope_periods[rate])
+        return;
+
+      v.rate_counter = 0;
+
+      if (v.state != Attack && ++v.exponential_counter < v.exponential_period)
+        return;
+
+      v.exponential_counter = 0;
+
+      switch (v.state)
+      {
+        case Attack:
+          if (++v.envelope == 0xff)
+            v.state = Decay_sustain;
+          break;
+
+        case Decay_sustain:
+          if (v.envelope != (v.sustain_release >> 4) * 0x11)
+            --v.envelope;
+          break;
+
+        case Release:
+          if (v.envelope)
+            --v.envelope;
+          break;
+      }
+
+      // Decay and release slow down as the level falls
+      switch (v.envelope)
+      {
+        case 0xff: v.exponential_period = 1;  break;
+        case 0x5d: v.exponential_period = 2;  break;
+        case 0x36: v.exponential_period = 4;  break;
+        case 0x1a: v.exponential_period = 8;  break;
+        case 0x0e: v.exponential_period = 16; break;
+        case 0x06: v.exponential_period = 30; break;
+        case 0x00: v.exponential_period = 1;  break;
+      }
+    }
+
+    // 12 bit waveform output of voice i
+    uint16_t waveform (uint8_t i) const
+    {
+      auto & v = _voices[i];
+      auto & source = _voices[(i + 2) % 3];
+      uint16_t out = 0xfff;
+      uint8_t  shape = v.control >> 4;
+
+      if (!shape)
+        return 0;
+
+      if (shape & 0x1)
+      {
+        uint32_t msb = (v.control & Ringmod_bit) ? (v.acc ^ source.acc) : v.acc;
+        out &= (((msb & 0x800000) ? ~v.acc : v.acc) >> 11) & 0xfff;
+      }
+
+      if (shape & 0x2)
+      {
+        out &= v.acc >> 12;
+      }
+
+      if (shape & 0x4)
+      {
+        out &= ((v.control & _BV (3)) || (v.acc >> 12) >= v.pw) ? 0xfff : 0;
+      }
+
+      if (shape & 0x8)
+      {
+        uint32_t n = v.noise;
+        out &= ((n >> 9) & 0x800) | ((n >> 8) & 0x400) | ((n >> 5) & 0x200) | ((n >> 3) & 0x100)
+             | ((n >> 2) & 0x080) | ((n << 1) & 0x040) | ((n << 3) & 0x020) | ((n << 4) & 0x010);
+      }
+
+      return out;
+    }
+
+    int32_t mix ()
+    {
+      float filtered = 0;
+      float direct = 0;
+
+      for (uint8_t i = 0; i < 3; ++i)
+      {
+        float out = ((int32_t) waveform (i) - 0x800) * _voices[i].envelope;
+
+        if (_res_filt & _BV (i))
+          filtered += out;
+
+        // Voice 3 can be taken off the output unless it goes through the filter
+        else if (i != 2 || !(_mode_vol & 0x80))
+          direct += out;
+      }
+
+      // Two integrator state variable filter, one step per cycle
+      float hp = filtered - _lp - _bp * _q_inv;
+      _bp += _w0 * hp;
+      _lp += _w0 * _bp;
+
+      float out = direct;
+
+      if (_mode_vol & Filt_lp_bit)
+        out += _lp;
+
+      if (_mode_vol & Filt_bp_bit)
+        out += _bp;
+
+      if (_mode_vol & Filt_hp_bit)
+        out += hp;
+
+      return (int32_t) (out * (_mode_vol & 0x0f) / 15);
+    }
+
+    void update_filter ()
+    {
+      float x = _cutoff / 2047.0f;
+      float res = (_res_filt >> 4) / 15.0f;
+      float fc;
+      float q;
+
+      if (_model == Mos6581)
+      {
+        // Flat at the bottom, steep at the top
+        fc = 220 + 17800 * x * x;
+        q = 0.707f + res;
+      }
+
+      else
+      {
+        // Close to linear, with stronger resonance
+        fc = 30 + 12000 * x;
+        q = 0.707f * powf (2, res * 2);
+      }
+
+      _w0 = 2 * (float) M_PI * fc / Clock_rate;
+      _q_inv = 1 / q;
+    }
+
+    Model    _model;
+    Voice    _voices[3];
+    uint16_t _cutoff;
+    uint8_t  _res_filt;
+    uint8_t  _mode_vol;
+    float    _lp;
+    float    _bp;
+    float    _w0;
+    float    _q_inv;
+    float    _dc;
+    uint32_t _phase;
+};
+
+// Sid Device writing into the emulator of the current thread
+struct Emulator_device
+{
+  static void write (uint8_t address, uint8_t data)
+  {
+    emulator->write (address, data);
+  }
+
+  static thread_local Sid_emulator * emulator;
+};
+
+thread_local Sid_emulator * Emulator_device::emulator;
+
+}
+
+#endif /* _HOST_SID_EMULATOR_H */
@@ -0,0 +1,223 @@
+#ifndef _HOST_SMF_H
+#define _HOST_SMF_H
+
+// Standard MIDI file reader. All tracks are merged into one list of
+// channel messages with absolute times in microseconds, following the
+// tempo map. System exclusive and meta events other than tempo are
+// skipped.
+
+#include <stdint.h>
+#include <stdio.h>
+#include <algorithm>
+#include <vector>
+
+namespace host
+{
+
+struct Midi_event
+{
+  uint64_t time;      // us
+  uint8_t  data[3];
+  uint8_t  length;
+};
+
+class Smf_reader
+{
+  struct Raw_event
+  {
+    uint32_t tick;
+    uint32_t order;
+    uint32_t tempo;   // us per quarter for tempo events, 0 otherwise
+    uint8_t  data[3];
+    uint8_t  length;
+  };
+
+  public:
+    // Returns false if the file is not a standard MIDI file this reader
+    // understands (SMPTE time division is not supported).
+    bool read (const char * path, std::vector<Midi_event> & events)
+    {
+      FILE * f = fopen (path, "rb");
+
+      if (!f)
+        return false;
+
+      _data.clear ();
+      int c;
+
+      while ((c = fgetc (f)) != EOF)
+      {
+        _data.push_back (c);
+      }
+
+      fclose (f);
+      _pos = 0;
+
+      if (!expect ("MThd") || be (4) < 6)
+        return false;
+
+      be (2);
+      uint16_t tracks = be (2);
+      uint16_t division = be (2);
+
+      if (division & 0x8000 || division == 0)
+        return false;
+
+      std::vector<Raw_event> raw;
+
+      for (uint16_t t = 0; t < tracks && _pos < _data.size (); ++t)
+      {
+        if (!read_track (raw))
+          return false;
+      }
+
+      std::sort (raw.begin (), raw.end (), [] (const Raw_event & a, const Raw_event & b)
+      {
+        return a.tick != b.tick ? a.tick < b.tick : a.order < b.order;
+      });
+
+      uint32_t tempo = 500000;
+      uint32_t last_tick = 0;
+      uint64_t time = 0;
+
+      events.clear ();
+
+      for (auto & e : raw)
+      {
+        time += (uint64_t) (e.tick - last_tick) * tempo / division;
+        last_tick = e.tick;
+
+        if (e.tempo)
+        {
+          tempo = e.tempo;
+          continue;
+        }
+
+        Midi_event m { time, { e.data[0], e.data[1], e.data[2] }, e.length };
+        events.push_back (m);
+      }
+
+      return true;
+    }
+
+  private:
+
+    bool read_track (std::vector<Raw_event> & raw)
+    {
+      if (!expect ("MTrk"))
+        return false;
+
+      uint32_t length = be (4);
+      size_t   end = _pos + length;
+      uint32_t tick = 0;
+      uint8_t  status = 0;
+
+      if (end > _data.size ())
+        return false;
+
+      while (_pos < end)
+      {
+        tick += vlq ();
+
+        if (_pos >= end)
+          return false;
+
+        uint8_t byte = _data[_pos];
+
+        if (byte == 0xff)
+        {
+          _pos++;
+          uint8_t type = next ();
+          uint32_t n = vlq ();
+
+          if (type == 0x51 && n == 3)
+            raw.push_back ({ tick, (uint32_t) raw.size (), (uint32_t) be (3), {}, 0 });
+          else
+            _pos += n;
+
+          continue;
+        }
+
+        if (byte == 0xf0 || byte == 0xf7)
+        {
+          _pos++;
+          _pos += vlq ();
+          continue;
+        }
+
+        // Running status
+        if (byte & 0x80)
+        {
+          status = byte;
+          _pos++;
+        }
+
+        if (!status)
+          return false;
+
+        uint8_t n = ((status & 0xe0) == 0xc0) ? 1 : 2;
+        Raw_event e { tick, (uint32_t) raw.size (), 0, { status, 0, 0 }, (uint8_t) (n + 1) };
+
+        for (uint8_t i = 0; i < n; ++i)
+        {
+          e.data[i + 1] = next () & 0x7f;
+        }
+
+        raw.push_back (e);
+      }
+
+      _pos = end;
+      return true;
+    }
+
+    bool expect (const char * id)
+    {
+      for (uint8_t i = 0; i < 4; ++i)
+      {
+        if (next () != (uint8_t) id[i])
+          return false;
+      }
+
+      return true;
+    }
+
+    uint8_t next ()
+    {
+      return _pos < _data.size () ? _data[_pos++] : 0;
+    }
+
+    uint32_t be (uint8_t bytes)
+    {
+      uint32_t v = 0;
+
+      for (uint8_t i = 0; i < bytes; ++i)
+      {
+        v = v << 8 | next ();
+      }
+
+      return v;
+    }
+
+    uint32_t vlq ()
+    {
+      uint32_t v = 0;
+
+      for (uint8_t i = 0; i < 4; ++i)
+      {
+        uint8_t b = next ();
+        v = v << 7 | (b & 0x7f);
+
+        if (!(b & 0x80))
+          break;
+      }
+
+      return v;
+    }
+
+    std::vector<uint8_t> _data;
+    size_t               _pos;
+};
+
+}
+
+#endif /* _HOST_SMF_H */
@@ -0,0 +1,137 @@
+#ifndef _HOST_SYNTH_H
+#define _HOST_SYNTH_H
+
+// The firmware's Engine on a Sid with an injected Device, with the frame
+// tasks and the EEPROM interrupt run by host time: every frame does what
+// the scheduler in sid.cc does after draining MIDI, and a queued bank
+// write moves one byte per EEPROM write cycle.
+
+#include <stdint.h>
+#include <string.h>
+#include "devices.h"
+
+#define ENGINE_STORAGE thread_local
+
+#include "engine.h"
+#include "midi.h"
+#include "scheduler.h"
+#include "eeprom_queue.h"
+
+namespace host
+{
+
+// Bytes per second at 31250 baud, 10 bits per byte
+static constexpr uint32_t Midi_us_per_byte = 320;
+
+// Control frame period of the firmware's scheduler
+static constexpr uint32_t Frame_us = (uint32_t) ((Clock_rate + Default_frame_rate / 2) / Default_frame_rate)
+                                   * Clock_counts * Clock_us_per_count;
+
+template<class Device>
+struct Synth : Engine<Device>
+{
+  typedef Engine<Device> Base;
+
+  // Starts from power on: fresh engine, empty bank, time zero
+  static void init ()
+  {
+    while (_eeprom_queue.busy ())
+    {
+      EE_READY_vect ();
+    }
+
+    _host_time = 0;
+    frame_time = Frame_us;
+    eeprom_time = Eeprom_write_us;
+    redraws = 0;
+    memset (eeprom_bank, 0xff, sizeof (eeprom_bank));
+
+    Base::sid = Sid<Device> ();
+    Base::settings = Settings ();
+    Base::cache = Patch_cache ();
+    Base::morph = Morph ();
+    Base::modulation = Modulation ();
+    Base::sysex = Sysex<Base> ();
+    Base::morph_deferred = 0;
+    Base::deferred_program = No_program;
+    Base::notes = 0;
+    Base::program_pending = false;
+    Base::changed = false;
+    Base::init ();
+  }
+
+  // Time of the next frame or EEPROM write cycle
+  static uint32_t next ()
+  {
+    return frame_time < eeprom_time ? frame_time : eeprom_time;
+  }
+
+  // Runs the next frame or EEPROM write cycle, at its time
+  static void step ()
+  {
+    _host_time = next ();
+
+    if (eeprom_time == _host_time)
+    {
+      if (_eeprom_queue.busy ())
+        EE_READY_vect ();
+
+      eeprom_time += Eeprom_write_us;
+    }
+
+    if (frame_time == _host_time)
+    {
+      Base::tick ();
+      Base::background ();
+      Base::flush ();
+      Base::poll ();
+
+      if (Base::take_changed ())
+        redraws++;
+
+      frame_time += Frame_us;
+    }
+  }
+
+  static void run_until (uint32_t time)
+  {
+    while (next () <= time)
+    {
+      step ();
+    }
+
+    _host_time = time;
+  }
+
+  static thread_local uint32_t frame_time;
+  static thread_local uint32_t eeprom_time;
+
+  // Frames after which the firmware would have redrawn the screen
+  static thread_local uint32_t redraws;
+};
+
+template<class Device> thread_local uint32_t Synth<Device>::frame_time;
+template<class Device> thread_local uint32_t Synth<Device>::eeprom_time;
+template<class Device> thread_local uint32_t Synth<Device>::redraws;
+
+// Plays raw MIDI bytes through Midi<Synth<Device>> as if they arrived back
+// to back, then lets one more frame pass so that everything is flushed.
+template<class Device>
+void play (const uint8_t * data, uint32_t length)
+{
+  Serial serial;
+  Midi<Synth<Device>, Serial> midi (serial);
+
+  for (uint32_t i = 0; i < length; ++i)
+  {
+    Synth<Device>::run_until (_host_time + Midi_us_per_byte);
+    serial.feed (data + i, 1);
+    midi.process_next ();
+  }
+
+  Synth<Device>::run_until (_host_time + Frame_us);
+}
+
+}
+
+#endif /* _HOST_SYNTH_H */
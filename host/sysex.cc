@@ -0,0 +1,58 @@
+// Writes the patch bank of an EEPROM image as system exclusive, one patch
+// message per stored program, for backing up a unit. The board has no MIDI
+// output, so the image is read with the programmer:
+//
+//   avrdude -p m328p -c usbtiny -U eeprom:r:eeprom.bin:r
+//   sysex eeprom.bin > bank.syx
+//
+// Sending bank.syx back restores it, with at least Record_write_ms between
+// messages for the bank to keep up:
+//
+//   amidi -p hw:1 -i 160 -s bank.syx
+
+#include <stdio.h>
+#include <string.h>
+#include "bank.h"
+#include "sysex_messages.h"
+
+int main (int argc, char * argv[])
+{
+  if (argc != 2)
+  {
+    fprintf (stderr, "usage: %s eeprom.bin > bank.syx\n", argv[0]);
+    return 2;
+  }
+
+  FILE * f = fopen (argv[1], "rb");
+
+  if (!f)
+  {
+    fprintf (stderr, "sysex: cannot read %s\n", argv[1]);
+    return 2;
+  }
+
+  // The bank is the only thing in EEPROM, so it starts at address 0
+  memset (eeprom_bank, 0xff, sizeof (eeprom_bank));
+  fread (eeprom_bank, 1, sizeof (eeprom_bank), f);
+  fclose (f);
+
+  Bank bank;
+  bank.init ();
+
+  uint8_t stored = 0;
+
+  for (uint8_t program = 0; program < Num_patches; ++program)
+  {
+    Patch patch;
+
+    if (!bank.load (program, patch))
+      continue;
+
+    auto m = host::patch_message (program, patch);
+    fwrite (m.data (), 1, m.size (), stdout);
+    stored++;
+  }
+
+  fprintf (stderr, "%u of %u programs stored, send %u ms apart\n", stored, Num_patches, Record_write_ms);
+  return 0;
+}
@@ -0,0 +1,37 @@
+#ifndef _HOST_SYSEX_MESSAGES_H
+#define _HOST_SYSEX_MESSAGES_H
+
+// Builds the system exclusive messages the firmware receives, for tools
+// and tests on the host.
+
+#include <stdint.h>
+#include <vector>
+#include "sysex.h"
+
+namespace host
+{
+
+typedef std::vector<uint8_t> Message;
+
+inline Message patch_message (uint8_t program, const Patch & patch)
+{
+  uint8_t body[1 + Sysex_packed_size];
+
+  body[0] = program;
+  sysex_pack (patch.data, Patch_size, body + 1);
+
+  Message m { 0xf0, Sysex_manufacturer, Sysex_device, Sysex_patch };
+  m.insert (m.end (), body, body + sizeof (body));
+  m.push_back (sysex_checksum (body, sizeof (body)));
+  m.push_back (0xf7);
+  return m;
+}
+
+inline Message parameter_message (uint8_t setting, uint8_t voice, uint8_t value)
+{
+  return { 0xf0, Sysex_manufacturer, Sysex_device, Sysex_parameter, setting, voice, value, 0xf7 };
+}
+
+}
+
+#endif /* _HOST_SYSEX_MESSAGES_H */
@@ -0,0 +1,33 @@
+// Captures the SID register writes for a MIDI stream. Raw MIDI bytes are
+// read from stdin and played through the synth with the tracing device;
+// the trace goes to stdout, as text or with -b in the binary format.
+
+#include <stdio.h>
+#include <string.h>
+#include "synth.h"
+#include "trace.h"
+
+using Synth = host::Synth<host::Trace_device>;
+
+int main (int argc, char * argv[])
+{
+  bool binary = argc > 1 && !strcmp (argv[1], "-b");
+
+  std::vector<uint8_t> input;
+  int c;
+
+  while ((c = getchar ()) != EOF)
+  {
+    input.push_back (c);
+  }
+
+  Synth::init ();
+  host::play<host::Trace_device> (input.data (), input.size ());
+
+  if (binary)
+    host::write_binary (stdout, host::Trace_device::trace);
+  else
+    host::write_text (stdout, host::Trace_device::trace);
+
+  return 0;
+}
@@ -0,0 +1,179 @@
+#ifndef _HOST_TRACE_H
+#define _HOST_TRACE_H
+
+// SID register write traces. Trace_device records every bus write with
+// the host time, and traces are stored either as text, one
+// "time address value" line per write, or as a compact binary file of
+// 6 byte records behind a "SIDT" magic.
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <vector>
+#include "devices.h"
+#include "sid.h"
+
+namespace host
+{
+
+struct Trace_record
+{
+  uint32_t time;     // us
+  uint8_t  address;
+  uint8_t  value;
+};
+
+using Trace = std::vector<Trace_record>;
+
+struct Trace_device
+{
+  static void write (uint8_t address, uint8_t data)
+  {
+    trace.push_back ({ _host_time, address, data });
+  }
+
+  static Trace trace;
+};
+
+Trace Trace_device::trace;
+
+static const char Trace_magic[4] = { 'S', 'I', 'D', 'T' };
+
+inline void write_text (FILE * f, const Trace & trace)
+{
+  for (auto & r : trace)
+  {
+    fprintf (f, "%u %02x %02x\n", r.time, r.address, r.value);
+  }
+}
+
+inline void write_binary (FILE * f, const Trace & trace)
+{
+  fwrite (Trace_magic, 1, sizeof (Trace_magic), f);
+
+  for (auto & r : trace)
+  {
+    uint8_t record[6] =
+    {
+      (uint8_t) r.time, (uint8_t) (r.time >> 8), (uint8_t) (r.time >> 16), (uint8_t) (r.time >> 24),
+      r.address, r.value,
+    };
+
+    fwrite (record, 1, sizeof (record), f);
+  }
+}
+
+// Reads either format. Returns false on malformed input.
+inline bool read_trace (FILE * f, Trace & trace)
+{
+  char magic[4];
+  trace.clear ();
+
+  if (fread (magic, 1, sizeof (magic), f) == sizeof (magic) && !memcmp (magic, Trace_magic, sizeof (magic)))
+  {
+    uint8_t record[6];
+
+    while (fread (record, 1, sizeof (record), f) == sizeof (record))
+    {
+      uint32_t time = record[0] | record[1] << 8 | record[2] << 16 | (uint32_t) record[3] << 24;
+      trace.push_back ({ time, record[4], record[5] });
+    }
+
+    return true;
+  }
+
+  rewind (f);
+
+  unsigned time, address, value;
+  int n;
+
+  while ((n = fscanf (f, "%u %x %x", & time, & address, & value)) == 3)
+  {
+    if (address >= Last_register || value > 0xff)
+      return false;
+
+    trace.push_back ({ time, (uint8_t) address, (uint8_t) value });
+  }
+
+  return n == EOF;
+}
+
+inline bool read_trace (const char * path, Trace & trace)
+{
+  FILE * f = fopen (path, "rb");
+
+  if (!f)
+    return false;
+
+  bool ok = read_trace (f, trace);
+  fclose (f);
+  return ok;
+}
+
+// Plays a trace into a device, setting the host clock to each record's
+// time before the write.
+template<class Device>
+void replay (const Trace & trace)
+{
+  for (auto & r : trace)
+  {
+    _host_time = r.time;
+    Device::write (r.address, r.value);
+  }
+}
+
+struct Trace_result
+{
+  bool     match;      // register file agrees at every time step
+  uint32_t time;       // first time step that differs
+  uint8_t  address;    // first register that differs there
+  uint32_t expected;   // writes in the reference trace
+  uint32_t actual;     // writes in the trace under test
+};
+
+// Checks a trace against a reference. Writes that share a time stamp come
+// from one MIDI message, so only the register file after each time step
+// has to agree; the writes that lead there may differ, which lets a
+// change drop redundant writes without failing.
+inline Trace_result compare (const Trace & expected, const Trace & actual)
+{
+  Trace_result result { true, 0, 0, (uint32_t) expected.size (), (uint32_t) actual.size () };
+
+  uint8_t a[Last_register] {};
+  uint8_t b[Last_register] {};
+  size_t  i = 0;
+  size_t  j = 0;
+
+  while (i < expected.size () || j < actual.size ())
+  {
+    uint32_t t = i < expected.size () ? expected[i].time : actual[j].time;
+
+    if (j < actual.size () && actual[j].time < t)
+      t = actual[j].time;
+
+    for (; i < expected.size () && expected[i].time == t; ++i)
+    {
+      a[expected[i].address] = expected[i].value;
+    }
+
+    for (; j < actual.size () && actual[j].time == t; ++j)
+    {
+      b[actual[j].address] = actual[j].value;
+    }
+
+    for (uint8_t reg = 0; reg < Last_register; ++reg)
+    {
+      if (a[reg] != b[reg])
+      {
+        result = { false, t, reg, result.expected, result.actual };
+        return result;
+      }
+    }
+  }
+
+  return result;
+}
+
+}
+
+#endif /* _HOST_TRACE_H */
@@ -0,0 +1,47 @@
+#ifndef _HOST_WAV_H
+#define _HOST_WAV_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <vector>
+
+namespace host
+{
+
+// Writes 16 bit mono PCM
+inline bool write_wav (const char * path, const std::vector<int16_t> & samples, uint32_t rate)
+{
+  FILE * f = fopen (path, "wb");
+
+  if (!f)
+    return false;
+
+  uint32_t data_size = samples.size () * 2;
+
+  auto u32 = [f] (uint32_t v) { for (int i = 0; i < 4; ++i) fputc (v >> (8 * i), f); };
+  auto u16 = [f] (uint16_t v) { fputc (v, f); fputc (v >> 8, f); };
+
+  fputs ("RIFF", f);
+  u32 (36 + data_size);
+  fputs ("WAVEfmt ", f);
+  u32 (16);
+  u16 (1);
+  u16 (1);
+  u32 (rate);
+  u32 (rate * 2);
+  u16 (2);
+  u16 (16);
+  fputs ("data", f);
+  u32 (data_size);
+
+  for (auto s : samples)
+  {
+    u16 (s);
+  }
+
+  return fclose (f) == 0;
+}
+
+}
+
+#endif /* _HOST_WAV_H */
@@ -1,7 +1,8 @@
 #ifndef _AVR_TYPES_H
 #define _AVR_TYPES_H
 
-#include <stdint.h> 
+#include <stdint.h>
+#include <avr/io.h>
 
 namespace atm8
 {
@@ -0,0 +1,239 @@
+#ifndef _BANK_H
+#define _BANK_H
+
+#include <stddef.h>
+#include <avr/eeprom.h>
+#include <util/crc16.h>
+#include "patch.h"
+#include "cc_map.h"
+#include "eeprom_queue.h"
+
+static constexpr uint8_t  Patch_version = 5;
+static constexpr uint8_t  Num_patches   = 16;
+static constexpr uint8_t  Num_slots     = 21;
+static constexpr uint8_t  No_slot       = 0xff;
+static constexpr uint16_t Eeprom_size   = 1024;
+
+// The CRC is last so it is the final field written for a record. A record
+// interrupted by a power loss fails the check and the previous copy of the
+// program, which is never overwritten in place, is used instead. Packed so
+// that host tools see the AVR layout and can read EEPROM images.
+struct __attribute__ ((packed)) Patch_record
+{
+  Patch       patch;
+  Cc_bindings controls;
+  uint8_t     program;
+  uint16_t    sequence;
+  uint8_t     version;
+  uint16_t    crc;
+};
+
+static constexpr uint8_t Record_crc_size = offsetof (Patch_record, crc);
+
+static_assert (sizeof (Patch_record) * Num_slots <= Eeprom_size, "bank does not fit the EEPROM");
+static_assert (Patch_version != 0xff, "unprogrammed EEPROM would pass as a record");
+
+// Time the EEPROM queue takes to write one record, 153 ms
+static constexpr uint16_t Record_write_ms = (sizeof (Patch_record) * (uint32_t) Eeprom_write_us + 999) / 1000;
+
+inline uint16_t record_crc (const Patch_record & r)
+{
+  auto data = (const uint8_t *) & r;
+  uint16_t crc = 0xffff;
+
+  for (uint8_t i = 0; i < Record_crc_size; ++i)
+  {
+    crc = _crc16_update (crc, data[i]);
+  }
+
+  return crc;
+}
+
+Patch_record EEMEM eeprom_bank[Num_slots];
+
+// Patch bank in EEPROM. Records are written as a log: every save goes to the
+// next free slot round-robin and carries a sequence number, so repeated
+// saves of one program are spread over all free slots and the previous
+// record stays intact until the new one is complete. Which slot holds each
+// program is worked out once at boot and kept in RAM.
+class Bank
+{
+  public:
+    Bank ()
+      : _next (0)
+      , _sequence (0)
+      , _saving (No_slot)
+    {
+      memset (_slots, No_slot, sizeof (_slots));
+    }
+
+    ~Bank ()
+    {
+    }
+
+    void init ()
+    {
+      uint16_t newest[Num_patches];
+      uint16_t last = 0;
+      bool found = false;
+
+      for (uint8_t i = 0; i < Num_slots; ++i)
+      {
+        Patch_record r;
+
+        if (!read (i, r) || r.program >= Num_patches)
+          continue;
+
+        auto & slot = _slots[r.program];
+
+        if (slot == No_slot || (int16_t) (r.sequence - newest[r.program]) > 0)
+        {
+          slot = i;
+          newest[r.program] = r.sequence;
+        }
+
+        // Sequences wrap, so they only compare against one actually seen
+        if (!found || (int16_t) (r.sequence - last) > 0)
+        {
+          found = true;
+          last = r.sequence;
+          _sequence = r.sequence + 1;
+          _next = i + 1;
+        }
+      }
+    }
+
+    bool stored (uint8_t program) const
+    {
+      return _slots[program] != No_slot;
+    }
+
+    bool load (uint8_t program, Patch & patch)
+    {
+      Patch_record r;
+
+      if (!load (program, r))
+        return false;
+
+      patch = r.patch;
+      return true;
+    }
+
+    bool load (uint8_t program, Cc_bindings & controls)
+    {
+      Patch_record r;
+
+      if (!load (program, r))
+        return false;
+
+      controls = r.controls;
+      return true;
+    }
+
+    bool load (uint8_t program, Patch & patch, Cc_bindings & controls)
+    {
+      Patch_record r;
+
+      if (!load (program, r))
+        return false;
+
+      patch = r.patch;
+      controls = r.controls;
+      return true;
+    }
+
+    // Queues the patch for writing and returns straight away. Returns false
+    // if a save is already in progress.
+    bool save (uint8_t program, const Patch & patch, const Cc_bindings & controls)
+    {
+      if (busy ())
+        return false;
+
+      auto slot = next_free ();
+
+      _record.patch    = patch;
+      _record.controls = controls;
+      _record.program  = program;
+      _record.sequence = _sequence;
+      _record.version  = Patch_version;
+      _record.crc      = record_crc (_record);
+
+      if (!_eeprom_queue.write (& _record, & eeprom_bank[slot], sizeof (_record)))
+        return false;
+
+      _saving = slot;
+      _next = slot + 1;
+      _sequence++;
+      return true;
+    }
+
+    bool busy () const
+    {
+      return _saving != No_slot;
+    }
+
+    // Returns true once when a queued save has reached the EEPROM.
+    bool poll ()
+    {
+      if (!busy () || _eeprom_queue.busy ())
+        return false;
+
+      _slots[_record.program] = _saving;
+      _saving = No_slot;
+      return true;
+    }
+
+  private:
+
+    bool load (uint8_t program, Patch_record & r)
+    {
+      return stored (program) && read (_slots[program], r);
+    }
+
+    // Reads a record and checks version and CRC in the same pass. A slot
+    // never written reads all 0xff, which fails the version byte; it is
+    // checked first so that blank slots cost one byte at boot.
+    static bool read (uint8_t slot, Patch_record & r)
+    {
+      auto src = (const uint8_t *) & eeprom_bank[slot];
+      auto dst = (uint8_t *) & r;
+      uint16_t crc = 0xffff;
+
+      if (eeprom_read_byte (src + offsetof (Patch_record, version)) != Patch_version)
+        return false;
+
+      for (uint8_t i = 0; i < sizeof (r); ++i)
+      {
+        dst[i] = eeprom_read_byte (src + i);
+
+        if (i < Record_crc_size)
+          crc = _crc16_update (crc, dst[i]);
+      }
+
+      return r.version == Patch_version && r.crc == crc;
+    }
+
+    uint8_t next_free ()
+    {
+      uint8_t slot = _next;
+
+      for (uint8_t i = 0; i < Num_slots; ++i, ++slot)
+      {
+        if (slot >= Num_slots)
+          slot = 0;
+
+        if (!memchr (_slots, slot, sizeof (_slots)))
+          break;
+      }
+
+      return slot;
+    }
+
+    Patch_record _record;
+    uint8_t      _slots[Num_patches];
+    uint8_t      _next;
+    uint16_t     _sequence;
+    uint8_t      _saving;
+};
+
+#endif /* _BANK_H */
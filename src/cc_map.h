@@ -0,0 +1,285 @@
+#ifndef _CC_MAP_H
+#define _CC_MAP_H
+
+#include <stdint.h>
+#include <string.h>
+#include <avr/pgmspace.h>
+#include "parameters.h"
+
+// Control change to parameter map. A patch stores up to Max_cc_bindings
+// (controller, target) pairs; selecting it builds a 128 entry table from
+// controller number to binding so a message costs one lookup. A target is
+// a setting and a voice, packed as setting << 2 | voice.
+//
+// Values are scaled to the parameter's range. Controllers 0-31 are the
+// MSB of a 14 bit pair whose LSB is the controller 32 higher: the MSB
+// applies the coarse value and the LSB refines it. NRPN reaches every
+// target without a binding: NRPN MSB (99) selects the voice, NRPN LSB
+// (98) the setting, and data entry (6, 38) sets the value. With 14 bits
+// the filter cutoff also sets the three fine cutoff bits of the SID.
+//
+// Learn mode binds the next controller moved to an armed target. The NRPN
+// and data entry controllers, LSBs and channel mode messages are not
+// learned.
+static constexpr uint8_t Max_cc_bindings = 8;
+static constexpr uint8_t No_binding      = 0xff;
+
+static constexpr uint8_t Cc_data_msb = 6;
+static constexpr uint8_t Cc_data_lsb = 38;
+static constexpr uint8_t Cc_nrpn_lsb = 98;
+static constexpr uint8_t Cc_nrpn_msb = 99;
+static constexpr uint8_t Cc_rpn_lsb  = 100;
+static constexpr uint8_t Cc_rpn_msb  = 101;
+
+inline uint8_t cc_target (uint8_t setting, uint8_t voice)
+{
+  return setting << 2 | voice;
+}
+
+inline uint8_t cc_target_setting (uint8_t target)
+{
+  return target >> 2;
+}
+
+inline uint8_t cc_target_voice (uint8_t target)
+{
+  return target & 3;
+}
+
+struct Cc_binding
+{
+  uint8_t cc;      // No_binding for an empty entry
+  uint8_t target;
+};
+
+// Stored form, kept in the bank record next to the patch
+struct Cc_bindings
+{
+  Cc_binding entries[Max_cc_bindings];
+};
+
+// Bindings of factory presets and programs stored without any: the
+// general MIDI brightness and timbre controllers on the filter
+const Cc_bindings default_cc_bindings PROGMEM =
+{{
+  { 74, FILTER_CUTOFF << 2 },
+  { 71, FILTER_RESONANCE << 2 },
+  { No_binding, 0 }, { No_binding, 0 }, { No_binding, 0 },
+  { No_binding, 0 }, { No_binding, 0 }, { No_binding, 0 },
+}};
+
+// Parameter value resolved from a controller, in 14 bits
+struct Cc_value
+{
+  uint8_t  setting;
+  uint8_t  voice;
+  uint16_t value;
+};
+
+class Cc_map
+{
+  public:
+    Cc_map ()
+      : _nrpn { 0x7f, 0x7f }
+      , _data_msb (0)
+      , _learn (No_binding)
+      , _edited (false)
+    {
+      clear ();
+    }
+
+    void clear ()
+    {
+      memset (& _bindings, No_binding, sizeof (_bindings));
+      memset (_table, No_binding, sizeof (_table));
+      memset (_msb, 0, sizeof (_msb));
+    }
+
+    void load (const Cc_bindings & bindings)
+    {
+      _bindings = bindings;
+      _edited = false;
+      memset (_table, No_binding, sizeof (_table));
+      memset (_msb, 0, sizeof (_msb));
+
+      for (uint8_t i = 0; i < Max_cc_bindings; ++i)
+      {
+        auto cc = _bindings.entries[i].cc;
+
+        if (cc < sizeof (_table))
+          _table[cc] = i;
+      }
+    }
+
+    void load_default ()
+    {
+      Cc_bindings bindings;
+      memcpy_P (& bindings, & default_cc_bindings, sizeof (bindings));
+      load (bindings);
+    }
+
+    const Cc_bindings & bindings () const
+    {
+      return _bindings;
+    }
+
+    // True once bindings were changed since the last load ()
+    bool edited () const
+    {
+      return _edited;
+    }
+
+    // Binds a controller, replacing its previous binding. Returns false
+    // when all entries are taken.
+    bool bind (uint8_t cc, uint8_t target)
+    {
+      uint8_t i = _table[cc];
+
+      for (uint8_t j = 0; i == No_binding && j < Max_cc_bindings; ++j)
+      {
+        if (_bindings.entries[j].cc == No_binding)
+          i = j;
+      }
+
+      if (i == No_binding)
+        return false;
+
+      _bindings.entries[i] = { cc, target };
+      _table[cc] = i;
+      _msb[i] = 0;
+      _edited = true;
+      return true;
+    }
+
+    // Removes every controller bound to target
+    void unbind (uint8_t target)
+    {
+      for (auto & b : _bindings.entries)
+      {
+        if (b.cc != No_binding && b.target == target)
+        {
+          _table[b.cc] = No_binding;
+          b.cc = No_binding;
+          _edited = true;
+        }
+      }
+    }
+
+    // Arms learning for target. Arming the armed target again clears its
+    // binding and stops learning.
+    void learn (uint8_t target)
+    {
+      if (_learn == target)
+      {
+        unbind (target);
+        _learn = No_binding;
+        return;
+      }
+
+      _learn = target;
+    }
+
+    // Armed target, No_binding when not learning
+    uint8_t learning () const
+    {
+      return _learn;
+    }
+
+    // Controller bound to target, No_binding for none
+    uint8_t find (uint8_t target) const
+    {
+      for (auto & b : _bindings.entries)
+      {
+        if (b.cc != No_binding && b.target == target)
+          return b.cc;
+      }
+
+      return No_binding;
+    }
+
+    // Returns true when the message sets a parameter, which it fills in.
+    // Controllers that are neither bound nor part of an NRPN, and NRPN
+    // messages that only select a parameter, return false.
+    bool control_change (uint8_t cc, uint8_t value, Cc_value & out)
+    {
+      if (_learn != No_binding && learnable (cc))
+      {
+        bind (cc, _learn);
+        _learn = No_binding;
+      }
+
+      uint8_t i = _table[cc];
+
+      if (i != No_binding)
+      {
+        _msb[i] = value;
+        return resolve (_bindings.entries[i].target, value << 7, out);
+      }
+
+      // LSB of a bound 14 bit pair
+      if (cc >= 32 && cc < 64 && (i = _table[cc - 32]) != No_binding)
+      {
+        return resolve (_bindings.entries[i].target, _msb[i] << 7 | value, out);
+      }
+
+      switch (cc)
+      {
+        case Cc_nrpn_msb:
+          _nrpn[0] = value;
+          break;
+
+        case Cc_nrpn_lsb:
+          _nrpn[1] = value;
+          break;
+
+        // An RPN deselects the NRPN
+        case Cc_rpn_msb:
+        case Cc_rpn_lsb:
+          _nrpn[0] = 0x7f;
+          break;
+
+        case Cc_data_msb:
+          _data_msb = value;
+          return resolve (_nrpn[1], _nrpn[0], value << 7, out);
+
+        case Cc_data_lsb:
+          return resolve (_nrpn[1], _nrpn[0], _data_msb << 7 | value, out);
+      }
+
+      return false;
+    }
+
+  private:
+
+    static bool learnable (uint8_t cc)
+    {
+      return cc < 120
+          && cc != Cc_data_msb
+          && (cc < 32 || cc >= 64)
+          && (cc < Cc_nrpn_lsb || cc > Cc_rpn_msb);
+    }
+
+    static bool resolve (uint8_t target, uint16_t value, Cc_value & out)
+    {
+      return resolve (cc_target_setting (target), cc_target_voice (target), value, out);
+    }
+
+    static bool resolve (uint8_t setting, uint8_t voice, uint16_t value, Cc_value & out)
+    {
+      if (setting >= Num_settings || voice >= get_voices (get_parameter (setting)))
+        return false;
+
+      out = { setting, voice, value };
+      return true;
+    }
+
+    Cc_bindings _bindings;
+    uint8_t     _table[128];
+    uint8_t     _msb[Max_cc_bindings];
+    uint8_t     _nrpn[2];    // voice, setting
+    uint8_t     _data_msb;
+    uint8_t     _learn;
+    bool        _edited;
+};
+
+#endif /* _CC_MAP_H */
@@ -0,0 +1,65 @@
+#ifndef _CLOCK_H
+#define _CLOCK_H
+
+#include <avr/io.h>
+#include <util/atomic.h>
+#include <stdint.h>
+
+// Time base on Timer0. The timer runs in CTC mode at F_CPU / 256 with
+// OCR0A = 63, so one tick is 64 timer counts (1.024 ms) and one count is
+// 16 us.
+static constexpr uint8_t  Clock_counts = 64;
+static constexpr uint8_t  Clock_us_per_count = 16;
+
+class Clock
+{
+  public:
+    Clock ()
+      : _ticks (0)
+    {
+    }
+
+    // Called from interrupt
+    void tick ()
+    {
+      _ticks++;
+    }
+
+    uint16_t ticks () const
+    {
+      uint16_t t;
+
+      ATOMIC_BLOCK (ATOMIC_RESTORESTATE)
+      {
+        t = _ticks;
+      }
+
+      return t;
+    }
+
+    // Timestamp in timer counts (16 us), wraps after ~1 s
+    uint16_t now () const
+    {
+      uint16_t t;
+      uint8_t  count;
+
+      ATOMIC_BLOCK (ATOMIC_RESTORESTATE)
+      {
+        t = _ticks;
+        count = TCNT0;
+
+        if ((TIFR0 & _BV (OCF0A)) && count < Clock_counts / 2)
+          t++;
+      }
+
+      return t * Clock_counts + count;
+    }
+
+  private:
+
+    volatile uint16_t _ticks;
+};
+
+Clock _clock;
+
+#endif /* _CLOCK_H */
@@ -0,0 +1,96 @@
+#ifndef _EEPROM_QUEUE_H
+#define _EEPROM_QUEUE_H
+
+#include "ringbuffer.h"
+#include "profile.h"
+
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <stdint.h>
+
+// Erase and write time of one EEPROM byte
+static constexpr uint16_t Eeprom_write_us = 3400;
+
+// Interrupt driven EEPROM writer. Jobs point at RAM that must stay untouched
+// until busy () goes false. The EE_READY interrupt writes one byte per
+// ready event, skipping bytes that already hold the wanted value, so the
+// main loop never waits for the erase/write cycle.
+class Eeprom_queue
+{
+  struct Job
+  {
+    const uint8_t * src;
+    uint8_t *       dst;
+    uint8_t         length;
+  };
+
+  public:
+    Eeprom_queue ()
+      : _current { nullptr, 0, 0 }
+      , _pos (0)
+    {
+    }
+
+    bool write (const void * src, void * dst, uint8_t length)
+    {
+      if (_jobs.full ())
+        return false;
+
+      _jobs.write ({ (const uint8_t *) src, (uint8_t *) dst, length });
+      EECR |= _BV (EERIE);
+      return true;
+    }
+
+    bool busy () const
+    {
+      return EECR & _BV (EERIE);
+    }
+
+    // Called from interrupt
+    void service ()
+    {
+      while (true)
+      {
+        if (_pos == _current.length)
+        {
+          if (_jobs.empty ())
+          {
+            EECR &= ~ _BV (EERIE);
+            return;
+          }
+
+          _current = _jobs.read ();
+          _pos = 0;
+          continue;
+        }
+
+        uint8_t value = _current.src[_pos];
+        EEAR = (uintptr_t) (_current.dst + _pos++);
+        EECR |= _BV (EERE);
+
+        if (EEDR != value)
+        {
+          EEDR = value;
+          EECR |= _BV (EEMPE);
+          EECR |= _BV (EEPE);
+          return;
+        }
+      }
+    }
+
+  private:
+
+    RingBuffer<Job, 4> _jobs;
+    Job                _current;
+    uint8_t            _pos;
+};
+
+Eeprom_queue _eeprom_queue;
+
+ISR(EE_READY_vect)
+{
+  PROFILE_SCOPE (Probe_eeprom_isr);
+  _eeprom_queue.service ();
+}
+
+#endif /* _EEPROM_QUEUE_H */
@@ -2,22 +2,39 @@
 #define _ENCODER_H_
 
 #include "avr_types.h"
+#include <avr/pgmspace.h>
+
+// Quadrature transitions indexed by (previous state << 2) | state, with
+// the state being (a << 1) | b. A full clockwise cycle is 00 10 11 01 00.
+// Transitions where both inputs changed at once are invalid and count as
+// no movement.
+const int8_t encoder_transitions[16] PROGMEM =
+{
+   0, -1,  1,  0,
+   1,  0,  0, -1,
+  -1,  0,  0,  1,
+   0,  1, -1,  0,
+};
+
+// Quarter steps per detent. The encoders rest at 00 and 11, so there are
+// two detents per full cycle.
+static constexpr int8_t Encoder_steps = 2;
 
 class Encoder
 {
   public:
-    
-    Encoder (atm8::reg ddr, atm8::reg pdr, atm8::reg prr, atm8::pin a, atm8::pin b, atm8::pin sw)
+
+    Encoder (atm8::reg ddr, atm8::reg pdr, atm8::reg prr, atm8::reg pcmsk, atm8::pin a, atm8::pin b, atm8::pin sw)
       : _ddr (ddr)
       , _pdr (pdr)
       , _prr (prr)
+      , _pcmsk (pcmsk)
       , _a (a)
       , _b (b)
       , _sw (sw)
-      , _enc_current (0xff)
+      , _state (0)
+      , _steps (0)
       , _switch (0xff)
-      , _a_state (0xff)
-      , _b_state (0xff)
     {
     }
 
@@ -32,67 +49,64 @@ class Encoder
       _ddr &= ~ _BV (_sw);
 
       _pdr |= _BV (_a) | _BV (_b) | _BV (_sw);
+
+      _state = read_state ();
+      _pcmsk |= _BV (_a) | _BV (_b);
     }
 
+    // Called from timer interrupt
     void debounce ()
     {
       auto sw = _prr & _BV (_sw);
       _switch = (_switch << 1) | !sw;
     }
 
-    int8_t read ()
+    // True for one debounce period after the switch settled down
+    bool pressed () const
     {
-      auto a = _prr & _BV (_a);
-      auto b = _prr & _BV (_b);
-
-      uint8_t result = 0;
-      int8_t inc = 0;
-
-      if (a)
-      {
-        result |= 1 << 1;
-      }
+      return _switch == 0x7f;
+    }
 
-      if (b)
-      {
-        result |= 1 << 0;
-      }
+    // Called from pin change interrupt. Returns -1, 0 or 1 detents.
+    int8_t decode ()
+    {
+      uint8_t state = read_state ();
+      _steps += (int8_t) pgm_read_byte (& encoder_transitions[(_state << 2) | state]);
+      _state = state;
 
-      if (result != _enc_current)
+      if (_steps >= Encoder_steps)
       {
-        if((_enc_current == 3 && result == 1) || (_enc_current == 0 && result == 2)) 
-        { 
-          inc = 1;
-        } 
-
-        else if ((_enc_current == 2 && result == 0) || (_enc_current == 1 && result == 3)) 
-        { 
-          inc = -1;
-        } 
-        
-        _enc_current = result;
+        _steps -= Encoder_steps;
+        return 1;
       }
 
-      if (_switch == 0x7f)
+      if (_steps <= -Encoder_steps)
       {
-        return 88;
+        _steps += Encoder_steps;
+        return -1;
       }
 
-      return inc;
+      return 0;
     }
 
   private:
 
+    uint8_t read_state () const
+    {
+      uint8_t pins = _prr;
+      return (pins & _BV (_a) ? 2 : 0) | (pins & _BV (_b) ? 1 : 0);
+    }
+
     atm8::reg _ddr;
     atm8::reg _pdr;
     atm8::reg _prr;
+    atm8::reg _pcmsk;
     atm8::pin _a;
     atm8::pin _b;
     atm8::pin _sw;
-    uint8_t   _enc_current;
+    uint8_t   _state;
+    int8_t    _steps;
     uint8_t   _switch;
-    uint8_t   _a_state;
-    uint8_t   _b_state;
 };
 
 #endif /* _ENCODER_H_ */
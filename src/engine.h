@@ -0,0 +1,413 @@
+#ifndef _ENGINE_H
+#define _ENGINE_H
+
+#include <stdint.h>
+#include "sid.h"
+#include "settings.h"
+#include "patch_cache.h"
+#include "morph.h"
+#include "modulation.h"
+#include "notes.h"
+#include "sysex.h"
+#include "clock.h"
+#include "profile.h"
+
+// Storage of the engine state. Host renders run one engine per thread and
+// define this as thread_local.
+#ifndef ENGINE_STORAGE
+#define ENGINE_STORAGE
+#endif
+
+static constexpr uint8_t Morph_cc = 1;
+
+// The synth behind the serial input: notes, program changes, controllers
+// and system exclusive messages in, register writes out through a Sid on
+// TDevice. It is the callback of both Midi<> and Sysex<>. The firmware
+// runs it on the shift register in sid.cc, the host tools and tests on
+// the devices in host/, so they all play the same code.
+//
+// Handlers run as the bytes arrive. The rest is done from the frame
+// tasks: tick () moves the morph and applies pressure, background ()
+// decodes programs ahead, flush () writes the changed registers and poll ()
+// follows the bank. Whatever the screen shows that changed meanwhile is
+// reported once by take_changed ().
+template<class TDevice>
+struct Engine
+{
+  static void init ()
+  {
+    settings.init ();
+    select_morph_source (0, 0);
+    select_morph_source (1, 1);
+    sid.init ();
+
+    apply_patch (sid, settings.patch ());
+
+    sid.set_volume (Master_volume);
+    sid.update ();
+  }
+
+  // Channels past the third play the first voice
+  static uint8_t voice (uint8_t channel)
+  {
+    return channel < 3 ? channel : 0;
+  }
+
+  static void note_on (uint8_t channel, uint8_t note, uint8_t velocity)
+  {
+    PROFILE_SCOPE (Probe_note_on);
+    uint8_t v = voice (channel);
+
+    sid.set_frequency (v, note_frequency (note));
+    modulation.note_on (sid, settings.patch (), v, velocity);
+    sid.gate (v, true);
+    sid.update ();
+    notes |= 1 << v;
+  }
+
+  static void note_off (uint8_t channel)
+  {
+    uint8_t v = voice (channel);
+
+    sid.gate (v, false);
+    sid.update ();
+    notes &= ~ (1 << v);
+  }
+
+  static void program_change (uint8_t channel, uint8_t program)
+  {
+    select_program (program);
+  }
+
+  static void pressure (uint8_t channel, uint8_t value)
+  {
+    modulation.pressure (voice (channel), value);
+  }
+
+  // Controller values are scaled to the parameter's range and only reach
+  // the registers and the screen when the value changes. A 14 bit cutoff
+  // also sets the fine bits below the patch resolution. Unbound
+  // controllers fall through to the morph, which ignores them unless it
+  // is enabled.
+  static void control_change (uint8_t channel, uint8_t control, uint8_t value)
+  {
+    auto & controls = settings.controls ();
+    bool learning = controls.learning () != No_binding;
+    Cc_value c;
+
+    if (!controls.control_change (control, value, c))
+    {
+      if (control == Morph_cc)
+        morph.set_position (value);
+    }
+
+    else
+    {
+      auto s = static_cast<Setting> (c.setting);
+      auto p = get_parameter (s);
+      uint8_t v = (c.value >> 7) * (p.max + 1) >> 7;
+
+      if (v != settings.get (s, c.voice))
+      {
+        set_parameter (s, c.voice, v);
+        changed = true;
+      }
+
+      if (s == FILTER_CUTOFF)
+        sid.set_filter_cutoff (c.value >> 4);
+    }
+
+    if (learning)
+      changed = true;
+  }
+
+  static void pitch_bend (uint8_t channel, int32_t value)
+  {
+  }
+
+  static void clock (uint8_t counter)
+  {
+  }
+
+  static void sysex_start ()
+  {
+    sysex.start ();
+  }
+
+  static void sysex_data (uint8_t data)
+  {
+    sysex.data (data);
+  }
+
+  static void sysex_end (bool complete)
+  {
+    sysex.end (complete);
+  }
+
+  // Bank programs are queued for the EEPROM; the current program and the
+  // edit buffer also replace the sound being played
+  static bool patch (uint8_t program, const Patch & data)
+  {
+    Patch patch;
+    Settings::sanitize (data, patch);
+
+    if (program != Sysex_edit_buffer)
+    {
+      if (!settings.store (program, patch))
+        return false;
+
+      cache.invalidate (program);
+
+      if (program != settings.program ())
+        return true;
+    }
+
+    Register_image image;
+    image.decode (patch);
+
+    cache.invalidate (settings.program ());
+    settings.edit (patch);
+    sid.load_image (image.regs, notes);
+    morph.invalidate ();
+    modulation.invalidate ();
+    changed = true;
+    return true;
+  }
+
+  static bool parameter (uint8_t setting, uint8_t voice, uint8_t value)
+  {
+    if (setting >= Num_settings)
+      return false;
+
+    auto p = get_parameter (setting);
+
+    if (voice >= get_voices (p) || value > p.max)
+      return false;
+
+    set_parameter (static_cast<Setting> (setting), voice, value);
+    changed = true;
+    return true;
+  }
+
+  // Sets a patch parameter and the registers it drives
+  static void set_parameter (Setting s, uint8_t voice, uint8_t value)
+  {
+    settings.set (s, voice, value);
+    cache.invalidate (settings.program ());
+    apply_parameter (sid, get_parameter (s), voice, value);
+  }
+
+  // Swaps in the decoded register image of a program. The registers are
+  // flushed together by the next flush (). A bank program that is not
+  // cached while the bank is being written is selected by background ()
+  // once the write is done.
+  static void select_program (uint8_t program)
+  {
+    if (program >= Num_programs)
+      return;
+
+    // Bindings learned on the program being left are not in its cached
+    // copy, so it is read again when selected next
+    if (settings.controls ().edited ())
+      cache.invalidate (settings.program ());
+
+    auto entry = cache.find (program);
+
+    if (!entry)
+    {
+      if (!readable (program))
+      {
+        deferred_program = program;
+        return;
+      }
+
+      entry = & decode (program);
+    }
+
+    deferred_program = No_program;
+    settings.select (program, entry->patch, entry->controls);
+    sid.load_image (entry->image.regs, notes);
+    morph.invalidate ();
+    modulation.invalidate ();
+
+    if (!program_pending)
+    {
+      program_time = _clock.now ();
+      program_pending = true;
+    }
+  }
+
+  // Program being played, or the one waiting for the bank
+  static uint8_t selected_program ()
+  {
+    return deferred_program != No_program ? deferred_program : settings.program ();
+  }
+
+  // Morph sources come from the cache, or from the bank when it is idle;
+  // otherwise they are read by background () like deferred programs
+  static void select_morph_source (uint8_t index, uint8_t program)
+  {
+    auto entry = cache.find (program);
+
+    morph_programs[index] = program;
+    morph_deferred &= ~ (1 << index);
+
+    if (entry)
+    {
+      morph.set_source (index, entry->patch);
+    }
+
+    else if (readable (program))
+    {
+      Patch patch;
+      settings.read (program, patch);
+      morph.set_source (index, patch);
+    }
+
+    else
+    {
+      morph_deferred |= 1 << index;
+    }
+  }
+
+  // An enabled morph is an edit of the current program, so SAVE stores the
+  // sound being played and velocity and pressure offsets are added to the
+  // blend. The morph writes plain values, so the offsets go back on top.
+  // Frequencies and gates in the edit buffer stay as they were.
+  static void tick ()
+  {
+    if (morph.update (sid))
+    {
+      Patch patch = settings.patch ();
+      morph.blend (patch);
+      settings.edit (patch);
+      cache.invalidate (settings.program ());
+      modulation.invalidate ();
+    }
+
+    modulation.update (sid, settings.patch ());
+  }
+
+  // Reads one program per frame while the bank is idle: first those put
+  // off by a write, then a neighbour so that stepping through programs
+  // hits the cache.
+  static void background ()
+  {
+    if (settings.saving ())
+      return;
+
+    if (deferred_program != No_program)
+    {
+      select_program (deferred_program);
+      return;
+    }
+
+    for (uint8_t index = 0; index < 2; ++index)
+    {
+      if (morph_deferred & (1 << index))
+      {
+        select_morph_source (index, morph_programs[index]);
+        return;
+      }
+    }
+
+    auto current = settings.program ();
+    uint8_t neighbours[]
+    {
+      (uint8_t) (current + 1 < Num_programs ? current + 1 : 0),
+      (uint8_t) (current > 0 ? current - 1 : Num_programs - 1),
+    };
+
+    for (auto program : neighbours)
+    {
+      if (!cache.find (program))
+      {
+        decode (program);
+        return;
+      }
+    }
+  }
+
+  // The bank cannot be read while a record is being written: a read
+  // between two bytes fails the CRC and returns the default patch.
+  // Presets are in flash.
+  static bool readable (uint8_t program)
+  {
+    return program >= Num_patches || !settings.saving ();
+  }
+
+  // Reads a program from the bank into the cache
+  static Patch_cache::Entry & decode (uint8_t program)
+  {
+    Patch       patch;
+    Cc_bindings controls;
+
+    settings.read (program, patch, controls);
+    return cache.insert (program, patch, controls);
+  }
+
+  static void flush ()
+  {
+    {
+      PROFILE_SCOPE (Probe_sid_update);
+      sid.update ();
+    }
+
+    if (program_pending)
+    {
+      program_latency = (_clock.now () - program_time) * Clock_us_per_count;
+      program_pending = false;
+      changed = true;
+    }
+  }
+
+  // Returns true once when the last save has completed
+  static bool poll ()
+  {
+    bool done = settings.poll ();
+
+    if (done)
+      changed = true;
+
+    return done;
+  }
+
+  static bool take_changed ()
+  {
+    bool c = changed;
+    changed = false;
+    return c;
+  }
+
+  static ENGINE_STORAGE Sid<TDevice>  sid;
+  static ENGINE_STORAGE Settings      settings;
+  static ENGINE_STORAGE Patch_cache   cache;
+  static ENGINE_STORAGE Morph         morph;
+  static ENGINE_STORAGE Modulation    modulation;
+  static ENGINE_STORAGE Sysex<Engine> sysex;
+  static ENGINE_STORAGE uint8_t       morph_programs[2];
+  static ENGINE_STORAGE uint8_t       morph_deferred;
+  static ENGINE_STORAGE uint8_t       deferred_program;
+  static ENGINE_STORAGE uint8_t       notes;
+  static ENGINE_STORAGE bool          program_pending;
+  static ENGINE_STORAGE uint16_t      program_time;
+  static ENGINE_STORAGE uint16_t      program_latency;
+  static ENGINE_STORAGE bool          changed;
+};
+
+template<class TDevice> ENGINE_STORAGE Sid<TDevice>           Engine<TDevice>::sid;
+template<class TDevice> ENGINE_STORAGE Settings               Engine<TDevice>::settings;
+template<class TDevice> ENGINE_STORAGE Patch_cache            Engine<TDevice>::cache;
+template<class TDevice> ENGINE_STORAGE Morph                  Engine<TDevice>::morph;
+template<class TDevice> ENGINE_STORAGE Modulation             Engine<TDevice>::modulation;
+template<class TDevice> ENGINE_STORAGE Sysex<Engine<TDevice>> Engine<TDevice>::sysex;
+template<class TDevice> ENGINE_STORAGE uint8_t                Engine<TDevice>::morph_programs[2];
+template<class TDevice> ENGINE_STORAGE uint8_t                Engine<TDevice>::morph_deferred;
+template<class TDevice> ENGINE_STORAGE uint8_t                Engine<TDevice>::deferred_program = No_program;
+template<class TDevice> ENGINE_STORAGE uint8_t                Engine<TDevice>::notes;
+template<class TDevice> ENGINE_STORAGE bool                   Engine<TDevice>::program_pending;
+template<class TDevice> ENGINE_STORAGE uint16_t               Engine<TDevice>::program_time;
+template<class TDevice> ENGINE_STORAGE uint16_t               Engine<TDevice>::program_latency;
+template<class TDevice> ENGINE_STORAGE bool                   Engine<TDevice>::changed;
+
+#endif /* _ENGINE_H */
@@ -1,231 +1,146 @@
 #ifndef _MENU_H
 #define _MENU_H
 
-class Menu;
-class MenuItem;
+#include <stdint.h>
+#include <avr/pgmspace.h>
 
-class MenuItem
-{
-  public:
-    using ReadF =  void (*)(char *);
-    using WriteF = void (*)(int8_t);
-
-    MenuItem ()
-    {
-    }
+// Menu tables live in flash. A page is a title row followed by `count`
+// setting ids, and navigation is done with indices into the page table, so
+// the only RAM the menu needs is the current page and row.
 
-    MenuItem (const char * text, ReadF read, WriteF write)
-      : _text (text)
-      , _read (read)
-      , _write (write)
-      , _next (nullptr)
-      , _prev (nullptr)
-      , _parent (nullptr)
-      , _next_page (nullptr)
-      , _prev_page (nullptr)
-    {
-    }
-
-    void set_next (MenuItem & next)
-    {
-      _next = & next;
-    }
-
-    void set_prev (MenuItem & prev)
-    {
-      _prev = & prev;
-    }
-
-    void set_next_page (MenuItem & next)
-    {
-      _next_page = & next;
-    }
- 
-    void set_prev_page (MenuItem & prev)
-    {
-      _prev_page = & prev;
-    }
-     
-    MenuItem * get_next ()
-    {
-      return _next;
-    } 
-    
-    MenuItem * get_prev ()
-    {
-      return _prev;
-    } 
-
-    MenuItem * get_next_page ()
-    {
-      return _next_page;
-    }
-
-    MenuItem * get_prev_page ()
-    {
-      return _prev_page;
-    }
-
-    void set_parent (MenuItem & parent)
-    {
-      _parent = & parent;
-    }
-
-    void edit (int8_t v)
-    {
-      if (_write)
-        _write (v);
-    }
-
-    const char * get_text ()
-    {
-      return _text;
-    }
-
-    void get_value (char * value)
-    {
-      if (_read)
-        return _read (value);
-    }
-
-  private:
-    const char * _text;
-    ReadF   _read;
-    WriteF  _write; 
-    MenuItem * _next;
-    MenuItem * _prev;
-    MenuItem * _parent;
-    MenuItem * _next_page;
-    MenuItem * _prev_page;
+struct MenuPage
+{
+  const char *     title;
+  const uint8_t *  items;
+  uint8_t          count;
+  uint8_t          voice;
 };
 
+template<uint8_t N>
+constexpr MenuPage make_page (const char * title, const uint8_t (&items)[N], uint8_t voice = 0)
+{
+  return { title, items, N, voice };
+}
+
 class Menu
 {
   public:
     using RenderF = void (*)(uint8_t x, uint8_t y, const char * text, const char * val, bool current);
+    using ReadF   = const char * (*)(uint8_t setting, uint8_t voice, char * val);
+    using WriteF  = void (*)(uint8_t setting, uint8_t voice, int8_t v);
+    using RangeF  = uint8_t (*)(uint8_t setting);
 
-    Menu ()
-    {
-    }
-
-    Menu (MenuItem * item, RenderF render_f, const char * active_marker)
-      : _current (item)
+    template<uint8_t N>
+    Menu (const MenuPage (&pages)[N], RenderF render_f, ReadF read_f, WriteF write_f, RangeF range_f, const char * active_marker)
+      : _pages (pages)
+      , _num_pages (N)
+      , _page (0)
+      , _row (0)
       , _render (render_f)
+      , _read (read_f)
+      , _write (write_f)
+      , _range (range_f)
       , _active_marker (active_marker)
     {
     }
-    
-    template<uint8_t N>
-    void init (MenuItem * (&items)[N])
-    {
-      for (uint8_t i = 0; i < N; ++i)
-      {
-        auto & item = items[i][0];
 
-        if (i > 0)
-          item.set_prev_page (items[i - 1][0]);
-
-        if (i < N - 1)
-          item.set_next_page (items[i + 1][0]);
-      }
+    void navigate (int8_t steps)
+    {
+      auto page = get_page (_page);
+      _row = clamp (_row + steps, page.count);
     }
 
-    template<uint8_t N>
-    static void link_items (MenuItem (&items)[N])
+    void edit (int8_t steps)
     {
-      for (uint8_t i = 0; i < N; ++i)
+      if (_row > 0)
       {
-        auto & item = items[i];
-
-        if (i > 0) 
-          item.set_prev (items[i - 1]);
-
-        if (i < N - 1)
-          item.set_next (items[i + 1]);
+        auto page = get_page (_page);
+        _write (get_item (page, _row), page.voice, steps);
+        return;
       }
+
+      _page = clamp (_page + steps, _num_pages - 1);
     }
 
-    void navigate (int8_t direction)
+    // Largest value of the current row, used to pick an encoder
+    // acceleration curve. The title row has no range.
+    uint8_t range ()
     {
-      MenuItem * current = _current;;
+      if (_row == 0)
+        return 0;
 
-      switch (direction)
-      {
-        case -1:
-          current = _current->get_prev ();
-          break;
-
-        case 1:
-          current = _current->get_next ();
-          break;
-
-        default:
-          break;
-      }
-      if (current)
-        _current = current; 
+      return _range (get_item (get_page (_page), _row));
     }
 
-    void edit (int8_t direction)
+    // Setting id and voice of the current row. Returns false on the title
+    // row.
+    bool selected (uint8_t & setting, uint8_t & voice)
     {
-      if (!_current->get_prev_page () && !_current->get_next_page ())
-      {
-        _current->edit (direction);
-        return;
-      }
-
-      MenuItem * current = _current;;
-
-      switch (direction)
-      {
-        case -1:
-          current = _current->get_prev_page ();
-          break;
-
-        case 1:
-          current = _current->get_next_page ();
-          break;
+      if (_row == 0)
+        return false;
 
-        default:
-          break;
-      }
-      if (current)
-        _current = current;
+      auto page = get_page (_page);
+      setting = get_item (page, _row);
+      voice = page.voice;
+      return true;
     }
 
     void render ()
-    {     
+    {
       char buffer[8] {};
 
-      MenuItem * item = _current;
-
-      int8_t max_prevs = 0;
+      auto page = get_page (_page);
+      uint8_t row = _row > 7 ? _row - 7 : 0;
 
-      while (item->get_prev () && max_prevs < 7 )
+      for (uint8_t i = 0; i < 8; ++i, ++row)
       {
-        item = item->get_prev ();
-        max_prevs++;
-      }
+        if (row == 0)
+        {
+          _render (10, i, page.title, nullptr, row == _row);
+        }
 
-      for (int8_t i = 0; i < 8; ++i)
-      {
-        if (item)
+        else if (row <= page.count)
         {
-          item->get_value (buffer);
-          _render (10, i, item->get_text (), buffer, item == _current);
-          item = item->get_next ();
+          buffer[0] = 0;
+          auto text = _read (get_item (page, row), page.voice, buffer);
+          _render (10, i, text, buffer, row == _row);
         }
+
         else
         {
           _render (10, i, nullptr, nullptr, false);
         }
-      } 
+      }
     }
 
   private:
-    MenuItem *   _current;
-    RenderF      _render;
-    const char * _active_marker;
+
+    static uint8_t clamp (int16_t v, uint8_t max)
+    {
+      return v < 0 ? 0 : v > max ? max : v;
+    }
+
+    MenuPage get_page (uint8_t page)
+    {
+      MenuPage p;
+      memcpy_P (& p, & _pages[page], sizeof (p));
+      return p;
+    }
+
+    static uint8_t get_item (const MenuPage & page, uint8_t row)
+    {
+      return pgm_read_byte (& page.items[row - 1]);
+    }
+
+    const MenuPage * _pages;
+    uint8_t          _num_pages;
+    uint8_t          _page;
+    uint8_t          _row;
+    RenderF          _render;
+    ReadF            _read;
+    WriteF           _write;
+    RangeF           _range;
+    const char *     _active_marker;
 };
 
 /*
@@ -5,21 +5,30 @@
 #include "uart.h"
 #include <avr/io.h>
 
-template<class TCallback>
+template<class TCallback, class TSerial = Uart>
 class Midi
 {
   public:
 
-    Midi (Uart & serial)
+    Midi (TSerial & serial)
       : _serial (serial)
       , _running_status (0)
       , _expected (0)
       , _data_index (0)
       , _running (0)
       , _clk_counter (0)
+      , _sysex (false)
   {
   }
 
+    // Forgets running status and any partial message
+    void reset ()
+    {
+      _running_status = 0;
+      _data_index = 0;
+      _sysex = false;
+    }
+
     void process_next ()
     {
       if (!_serial.available ())
@@ -39,37 +48,50 @@ class Midi
         handle_finished (data);
       }
 
-      else 
+      else if (data >= 0x80)
       {
-        if (data >= 0x80)
+        // Any status byte ends system exclusive, only f7 completes it
+        if (_sysex)
         {
-          _running_status = data;
+          _sysex = false;
+          TCallback::sysex_end (data == 0xf7);
+        }
 
-          switch (data & 0xf0)
-          {
-            case 0x80:
-            case 0x90:
-            case 0xe0:
-              _expected = 2;
-              _data_index = 0;
-              break;
-
-            default:
-              break;
-          }
+        if (data == 0xf0)
+        {
+          _sysex = true;
+          TCallback::sysex_start ();
         }
 
-        else
+        _running_status = data;
+        _expected = data_length (data);
+        _data_index = 0;
+
+        // Exclusive, tune request and end of exclusive set no running status
+        if (_expected == 0)
         {
-          _data[_data_index++] = data;
+          _running_status = 0;
         }
+      }
+
+      else if (_sysex)
+      {
+        TCallback::sysex_data (data);
+      }
 
+      // Data bytes without a status to go with them are dropped
+      else if (_running_status && _expected)
+      {
+        _data[_data_index++] = data;
 
         if (_data_index == _expected)
         {
           handle_finished (_running_status);
-
           _data_index = 0;
+
+          // System common messages do not set running status
+          if (_running_status >= 0xf0)
+            _running_status = 0;
         }
       }
 
@@ -78,6 +100,24 @@ class Midi
 
   private:
 
+    // Data bytes that follow a status byte, 0 for none and for system
+    // exclusive, whose payload goes to the sysex callbacks
+    static uint8_t data_length (uint8_t status)
+    {
+      switch (status & 0xf0)
+      {
+        case 0xc0:
+        case 0xd0:
+          return 1;
+
+        case 0xf0:
+          return status == 0xf1 || status == 0xf3 ? 1 : status == 0xf2 ? 2 : 0;
+
+        default:
+          return 2;
+      }
+    }
+
     void handle_finished (uint8_t byte)
     {
       auto msb = byte & 0xf0;
@@ -94,7 +134,7 @@ class Midi
 
           else
           {
-            TCallback::note_on (lsb, _data[0]);
+            TCallback::note_on (lsb, _data[0], _data[1]);
           }
 
           break;
@@ -103,8 +143,26 @@ class Midi
             TCallback::note_off (lsb);
             break;
 
+        // Key pressure counts for the whole channel, each channel plays
+        // one voice
+        case 0xa0:
+            TCallback::pressure (lsb, _data[1]);
+            break;
+
+        case 0xb0:
+            TCallback::control_change (lsb, _data[0], _data[1]);
+            break;
+
+        case 0xc0:
+            TCallback::program_change (lsb, _data[0]);
+            break;
+
+        case 0xd0:
+            TCallback::pressure (lsb, _data[0]);
+            break;
+
         case 0xe0:
-            TCallback::pitch_bend (msb & 0x0f, (_data[0] & 0x7f) | (_data[1] & 0x7f) << 7);
+            TCallback::pitch_bend (lsb, (_data[0] & 0x7f) | (_data[1] & 0x7f) << 7);
             break;
 
         case 0xf0:
@@ -128,7 +186,8 @@ class Midi
                 {
                   TCallback::clock (_clk_counter);
 
-                  if (_clk_counter++ >= 24)
+                  // 24 clocks per beat, counted 0-23
+                  if (++_clk_counter >= 24)
                   {
                     _clk_counter = 0;
                   }
@@ -146,13 +205,14 @@ class Midi
       }
     }
 
-    Uart &                     _serial;
+    TSerial &                  _serial;
     uint8_t                    _running_status;
     uint8_t                    _data[2];
     uint8_t                    _expected;
     uint8_t                    _data_index;
     bool                       _running;
     uint8_t                    _clk_counter;
+    bool                       _sysex;
 };
  
 #endif /* _MIDI_HANDLER_H */
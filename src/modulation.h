@@ -0,0 +1,155 @@
+#ifndef _MODULATION_H
+#define _MODULATION_H
+
+#include <stdint.h>
+#include <avr/pgmspace.h>
+#include "patch.h"
+#include "parameters.h"
+
+// Velocity and pressure as modulation sources. Each voice routes both to
+// one destination apiece, with a depth of 0-15 (see the route bytes in
+// patch.h). Offsets are computed in 8 bit fixed point:
+//
+//   amount = source * depth >> 4            0-119 per source
+//   offset = amount * (max + 1) >> 7        in the parameter's range
+//
+// and added to the patch value, clamped to the range. Attack time is
+// shortened instead, so playing harder gives a sharper attack. Sources
+// routed to the same destination add up; the filter cutoff is shared, so
+// it follows the voice pushing it furthest.
+//
+// Velocity is applied at note on, before the note's registers are
+// flushed. Pressure is applied by update () at the control rate, as are
+// both after a program change or a morph step replaced the registers.
+// Voices whose routes are off cost a few byte compares per note, and
+// destinations not routed are left alone.
+const uint8_t mod_settings[] PROGMEM =
+{
+  0,               // Mod_off
+  VOICE_SUSTAIN,
+  FILTER_CUTOFF,
+  VOICE_PW,
+  VOICE_ATTACK,
+};
+
+static constexpr uint8_t Mod_route_mask = 0x07;
+
+class Modulation
+{
+  public:
+    Modulation ()
+      : _velocity {}
+      , _pressure {}
+      , _dirty (0)
+    {
+    }
+
+    template<class TSid>
+    void note_on (TSid & sid, const Patch & patch, uint8_t voice, uint8_t velocity)
+    {
+      _velocity[voice] = velocity;
+      apply (sid, patch, voice);
+    }
+
+    // The registers were replaced or the patch changed under the notes:
+    // every voice's offsets are written again by the next update ()
+    void invalidate ()
+    {
+      _dirty = _BV (0) | _BV (1) | _BV (2);
+    }
+
+    // Channel or key pressure, applied by the next update ()
+    void pressure (uint8_t voice, uint8_t value)
+    {
+      if (_pressure[voice] != value)
+      {
+        _pressure[voice] = value;
+        _dirty |= _BV (voice);
+      }
+    }
+
+    template<class TSid>
+    bool update (TSid & sid, const Patch & patch)
+    {
+      if (!_dirty)
+        return false;
+
+      for (uint8_t voice = 0; voice < 3; ++voice)
+      {
+        if (_dirty & _BV (voice))
+          apply (sid, patch, voice);
+      }
+
+      _dirty = 0;
+      return true;
+    }
+
+  private:
+
+    template<class TSid>
+    void apply (TSid & sid, const Patch & patch, uint8_t voice)
+    {
+      for (uint8_t dest = Mod_sustain; dest < Num_mod_destinations; ++dest)
+      {
+        if (!routed (patch, voice, dest))
+          continue;
+
+        uint8_t amount = this->amount (patch, voice, dest);
+
+        // The shared cutoff takes the largest amount of all voices
+        if (dest == Mod_cutoff)
+        {
+          for (uint8_t v = 0; v < 3; ++v)
+          {
+            uint8_t a = this->amount (patch, v, dest);
+
+            if (a > amount)
+              amount = a;
+          }
+        }
+
+        write (sid, patch, voice, dest, amount);
+      }
+    }
+
+    static bool routed (const Patch & patch, uint8_t voice, uint8_t dest)
+    {
+      return (patch.data[Patch_velocity + voice] & Mod_route_mask) == dest
+          || (patch.data[Patch_pressure + voice] & Mod_route_mask) == dest;
+    }
+
+    uint8_t amount (const Patch & patch, uint8_t voice, uint8_t dest) const
+    {
+      return scale (patch.data[Patch_velocity + voice], _velocity[voice], dest)
+           + scale (patch.data[Patch_pressure + voice], _pressure[voice], dest);
+    }
+
+    static uint8_t scale (uint8_t route, uint8_t source, uint8_t dest)
+    {
+      if ((route & Mod_route_mask) != dest)
+        return 0;
+
+      return source * (route >> 4) >> 4;
+    }
+
+    template<class TSid>
+    static void write (TSid & sid, const Patch & patch, uint8_t voice, uint8_t dest, uint8_t amount)
+    {
+      auto s = static_cast<Setting> (pgm_read_byte (& mod_settings[dest]));
+      auto p = get_parameter (s);
+
+      if (get_voices (p) == 1)
+        voice = 0;
+
+      int16_t offset = (uint16_t) amount * (p.max + 1) >> 7;
+      int16_t v = get_value (patch, p, voice) + (dest == Mod_attack ? -offset : offset);
+
+      apply_parameter (sid, p, voice, v < 0 ? 0 : v > p.max ? p.max : v);
+    }
+
+    uint8_t _velocity[3];
+    uint8_t _pressure[3];
+    uint8_t _dirty;
+};
+
+#endif /* _MODULATION_H */
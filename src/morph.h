@@ -0,0 +1,148 @@
+#ifndef _MORPH_H
+#define _MORPH_H
+
+#include "patch.h"
+#include "parameters.h"
+
+// Interpolates between two patches at control rate. Numeric parameters are
+// blended in fixed point (nibbles step through their 16 values), named ones
+// (shape, filter mode) and switches flip at the midpoint. Only parameters
+// whose blended value changed are pushed to the chip. Voice frequencies
+// and gates belong to the notes and are left out. The morph only plays
+// while enabled; it takes over from the live patch when it is enabled.
+class Morph
+{
+  public:
+    Morph ()
+      : _sources {}
+      , _current {}
+      , _position (0)
+      , _enabled (false)
+      , _dirty (false)
+      , _full (true)
+    {
+    }
+
+    void set_source (uint8_t index, const Patch & patch)
+    {
+      _sources[index] = patch;
+      _dirty = _enabled;
+      _full = true;
+    }
+
+    bool enabled () const
+    {
+      return _enabled;
+    }
+
+    void set_enabled (bool enabled)
+    {
+      _enabled = enabled;
+      _dirty = enabled;
+      _full = true;
+    }
+
+    uint8_t position () const
+    {
+      return _position;
+    }
+
+    // Blend last pushed to the chip, without frequencies and gates
+    const Patch & current () const
+    {
+      return _current;
+    }
+
+    // Puts the blended parameters into a patch, leaving the others
+    void blend (Patch & patch) const
+    {
+      for (uint8_t s = 0; s < Num_settings; ++s)
+      {
+        if (!blended (s))
+          continue;
+
+        auto p = get_parameter (s);
+
+        for (uint8_t voice = 0; voice < get_voices (p); ++voice)
+        {
+          set_value (patch, p, voice, get_value (_current, p, voice));
+        }
+      }
+    }
+
+    // The registers were replaced from elsewhere: the next update rewrites
+    // every parameter instead of the changed ones
+    void invalidate ()
+    {
+      _full = true;
+    }
+
+    void set_position (uint8_t position)
+    {
+      if (position > 127)
+        return;
+
+      _position = position;
+      _dirty = _enabled;
+    }
+
+    template<class TSid>
+    bool update (TSid & sid)
+    {
+      if (!_dirty)
+        return false;
+
+      _dirty = false;
+
+      // 0..127 -> 0..128 so that 127 lands exactly on the second patch
+      uint8_t weight = _position + (_position >> 6);
+      bool changed = false;
+
+      for (uint8_t s = 0; s < Num_settings; ++s)
+      {
+        if (!blended (s))
+          continue;
+
+        auto p = get_parameter (s);
+
+        for (uint8_t voice = 0; voice < get_voices (p); ++voice)
+        {
+          int16_t a = get_value (_sources[0], p, voice);
+          int16_t b = get_value (_sources[1], p, voice);
+          uint8_t v;
+
+          if (p.names || p.max == 1)
+            v = weight < 64 ? a : b;
+
+          else
+            v = a + (((b - a) * weight + 64) >> 7);
+
+          if (_full || v != get_value (_current, p, voice))
+          {
+            set_value (_current, p, voice, v);
+            apply_parameter (sid, p, voice, v);
+            changed = true;
+          }
+        }
+      }
+
+      _full = false;
+      return changed;
+    }
+
+  private:
+
+    static bool blended (uint8_t setting)
+    {
+      return setting != VOICE_FREQUENCY && setting != VOICE_GATE;
+    }
+
+    Patch   _sources[2];
+    Patch   _current;
+    uint8_t _position;
+    bool    _enabled;
+    bool    _dirty;
+    bool    _full;
+};
+
+#endif /* _MORPH_H */
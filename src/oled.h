@@ -109,7 +109,8 @@ const uint8_t ASCII[][5] PROGMEM =
 const uint8_t oled_dc     = PD4;
 const uint8_t oled_cs     = PD5;
 
-struct Device
+// SSD1306 on the hardware SPI port
+struct Oled_spi
 {
   static void spi_transfer (uint8_t dc, uint8_t data)
   {
@@ -142,6 +143,7 @@ struct Device
   }
 };  
 
+template<class Device>
 class Oled
 {
   public:
@@ -0,0 +1,229 @@
+#ifndef _PARAMETERS_H
+#define _PARAMETERS_H
+
+#include <stdint.h>
+#include <avr/pgmspace.h>
+#include "sid.h"
+#include "patch.h"
+
+enum Setting
+{
+  VOICE_FREQUENCY = 0,
+  VOICE_SHAPE,
+  VOICE_PW,
+  VOICE_ATTACK,
+  VOICE_DECAY,
+  VOICE_SUSTAIN,
+  VOICE_RELEASE,
+  VOICE_GATE,
+  VOICE_FILTER,
+
+  FILTER_CUTOFF,
+  FILTER_RESONANCE,
+  FILTER_MODE,
+
+  VOICE_VELOCITY_DEST,
+  VOICE_VELOCITY_DEPTH,
+  VOICE_PRESSURE_DEST,
+  VOICE_PRESSURE_DEPTH,
+
+  Num_settings,
+};
+
+// Where velocity and pressure go, in the low bits of the route bytes
+enum Mod_destination
+{
+  Mod_off = 0,
+  Mod_sustain,
+  Mod_cutoff,
+  Mod_pulsewidth,
+  Mod_attack,
+
+  Num_mod_destinations,
+};
+
+Setting & operator++ (Setting & s)
+{
+  s = static_cast<Setting> (static_cast<int8_t> (s) + 1);
+  return s;
+}
+
+namespace strings
+{
+  const char attack     [] PROGMEM = "ATTACK";
+  const char decay      [] PROGMEM = "DECAY";
+  const char sustain    [] PROGMEM = "SUSTAIN";
+  const char release    [] PROGMEM = "RELEASE";
+  const char frequency  [] PROGMEM = "FREQ";
+  const char shape      [] PROGMEM = "SHAPE";
+  const char gate       [] PROGMEM = "GATE";
+  const char pulsewidth [] PROGMEM = "PW";
+  const char tri        [] PROGMEM = "TRI";
+  const char saw        [] PROGMEM = "SAW";
+  const char squ        [] PROGMEM = "SQU";
+  const char noise      [] PROGMEM = "NOI";
+  const char filter     [] PROGMEM = "FILTER";
+  const char resonance  [] PROGMEM = "RES";
+  const char cutoff     [] PROGMEM = "CUTOFF";
+  const char type       [] PROGMEM = "TYPE";
+  const char lp         [] PROGMEM = "LP";
+  const char bp         [] PROGMEM = "BP";
+  const char hp         [] PROGMEM = "HP";
+  const char vel_dest   [] PROGMEM = "VEL TO";
+  const char vel_depth  [] PROGMEM = "VEL DEPTH";
+  const char at_dest    [] PROGMEM = "AT TO";
+  const char at_depth   [] PROGMEM = "AT DEPTH";
+  const char off        [] PROGMEM = "OFF";
+  const char sus        [] PROGMEM = "SUS";
+  const char cut        [] PROGMEM = "CUT";
+  const char pw         [] PROGMEM = "PW";
+  const char atk        [] PROGMEM = "ATK";
+}
+
+const char * const shape_names[] PROGMEM =
+{
+  strings::tri,
+  strings::saw,
+  strings::squ,
+  strings::noise,
+};
+
+const char * const filter_mode_names[] PROGMEM =
+{
+  strings::lp,
+  strings::bp,
+  strings::hp,
+};
+
+const char * const mod_destination_names[] PROGMEM =
+{
+  strings::off,
+  strings::sus,
+  strings::cut,
+  strings::pw,
+  strings::atk,
+};
+
+// Parameter flags
+static constexpr uint8_t Per_voice = _BV (0); // register is offset by voice * Voice_registers
+static constexpr uint8_t Voice_bit = _BV (1); // shared register, field is shifted by voice
+static constexpr uint8_t Wide      = _BV (2); // field spans a lo/hi register pair
+static constexpr uint8_t One_hot   = _BV (3); // value selects a single bit in the field
+static constexpr uint8_t Adjacent  = _BV (4); // voices use consecutive patch bytes
+
+static constexpr uint8_t Voice_registers = Voice_2_freq_lo - Voice_1_freq_lo;
+
+struct Parameter
+{
+  const char *         label;
+  const char * const * names;  // value names, nullptr for numbers
+  uint8_t              max;
+  uint8_t              offset; // patch byte, voice 1 for per-voice parameters
+  uint8_t              bit;    // position of the value in the patch byte
+  uint8_t              width;  // bits used in the patch byte
+  uint8_t              reg;    // register of voice 1 for per-voice parameters, unused without a mask
+  uint8_t              shift;  // position of the value in the register (pair)
+  uint16_t             mask;   // register bits owned by the parameter
+  uint8_t              flags;
+};
+
+// One row per Setting, in enum order
+const Parameter parameters[] PROGMEM =
+{
+  //  label              names                  max  offset            bit width reg          shift  mask    flags
+  { strings::frequency,  nullptr,               127, Voice_frequency,  0, 7, Voice_1_freq_lo,  9, 0xffff, Per_voice | Wide     },
+  { strings::shape,      shape_names,             3, Voice_control,    4, 2, Voice_1_control,  4, 0x00f0, Per_voice | One_hot  },
+  { strings::pulsewidth, nullptr,               127, Voice_pulsewidth, 0, 7, Voice_1_pw_lo,    5, 0x0fff, Per_voice | Wide     },
+  { strings::attack,     nullptr,                15, Voice_ad,         4, 4, Voice_1_ad,       4, 0x00f0, Per_voice            },
+  { strings::decay,      nullptr,                15, Voice_ad,         0, 4, Voice_1_ad,       0, 0x000f, Per_voice            },
+  { strings::sustain,    nullptr,                15, Voice_sr,         4, 4, Voice_1_sr,       4, 0x00f0, Per_voice            },
+  { strings::release,    nullptr,                15, Voice_sr,         0, 4, Voice_1_sr,       0, 0x000f, Per_voice            },
+  { strings::gate,       nullptr,                 1, Voice_control,    0, 1, Voice_1_control,  0, 0x0001, Per_voice            },
+  { strings::filter,     nullptr,                 1, Voice_control,    1, 1, Filter_res_en,    0, 0x0001, Voice_bit            },
+  { strings::cutoff,     nullptr,               127, Patch_cutoff,     0, 7, Filter_cutoff_hi, 0, 0x00ff, 0                    },
+  { strings::resonance,  nullptr,                15, Patch_res_mode,   4, 4, Filter_res_en,    4, 0x00f0, 0                    },
+  { strings::type,       filter_mode_names,       2, Patch_res_mode,   0, 2, Filter_mode_vol,  4, 0x00f0, One_hot              },
+  { strings::vel_dest,   mod_destination_names,   4, Patch_velocity,   0, 3, 0,                0, 0x0000, Per_voice | Adjacent },
+  { strings::vel_depth,  nullptr,                15, Patch_velocity,   4, 4, 0,                0, 0x0000, Per_voice | Adjacent },
+  { strings::at_dest,    mod_destination_names,   4, Patch_pressure,   0, 3, 0,                0, 0x0000, Per_voice | Adjacent },
+  { strings::at_depth,   nullptr,                15, Patch_pressure,   4, 4, 0,                0, 0x0000, Per_voice | Adjacent },
+};
+
+inline Parameter get_parameter (uint8_t setting)
+{
+  Parameter p;
+  memcpy_P (& p, & parameters[setting], sizeof (p));
+  return p;
+}
+
+inline uint8_t get_voices (const Parameter & p)
+{
+  return (p.flags & (Per_voice | Voice_bit)) ? 3 : 1;
+}
+
+inline uint8_t get_offset (const Parameter & p, uint8_t voice)
+{
+  if (get_voices (p) == 1)
+    return p.offset;
+
+  return p.offset + voice * ((p.flags & Adjacent) ? 1 : Voice_size);
+}
+
+inline uint8_t get_value (const Patch & patch, const Parameter & p, uint8_t voice)
+{
+  return patch.get (get_offset (p, voice), p.bit, p.width);
+}
+
+inline void set_value (Patch & patch, const Parameter & p, uint8_t voice, uint8_t value)
+{
+  patch.set (get_offset (p, voice), p.bit, p.width, value);
+}
+
+// Parameters without register bits only live in the patch
+template<class TSid>
+void apply_parameter (TSid & sid, const Parameter & p, uint8_t voice, uint8_t value)
+{
+  if (!p.mask)
+    return;
+
+  uint8_t  reg   = p.reg;
+  uint8_t  shift = p.shift;
+  uint16_t mask  = p.mask;
+
+  if (p.flags & Per_voice)
+  {
+    reg += voice * Voice_registers;
+  }
+
+  if (p.flags & Voice_bit)
+  {
+    shift += voice;
+    mask <<= voice;
+  }
+
+  uint16_t bits = (p.flags & One_hot) ? _BV (value) : value;
+  uint16_t field = bits << shift;
+
+  sid.set_bits (reg, mask, field);
+
+  if (p.flags & Wide)
+  {
+    sid.set_bits (reg + 1, mask >> 8, field >> 8);
+  }
+}
+
+template<class TSid>
+void apply_patch (TSid & sid, const Patch & patch)
+{
+  for (uint8_t s = 0; s < Num_settings; ++s)
+  {
+    auto p = get_parameter (s);
+
+    for (uint8_t voice = 0; voice < get_voices (p); ++voice)
+    {
+      apply_parameter (sid, p, voice, get_value (patch, p, voice));
+    }
+  }
+}
+
+#endif /* _PARAMETERS_H */
@@ -0,0 +1,77 @@
+#ifndef _PATCH_H
+#define _PATCH_H
+
+#include <stdint.h>
+#include <string.h>
+#include <avr/pgmspace.h>
+
+// Packed patch layout. Each voice mirrors the SID voice registers where the
+// values line up: ad and sr are stored exactly as written to the chip, the
+// control byte keeps gate in bit 0 like the SID control register.
+//
+//   frequency   -fffffff  coarse frequency
+//   pulsewidth  -ppppppp  pulse width
+//   control     --ss--fg  shape, filter enable, gate
+//   ad          aaaadddd  attack, decay
+//   sr          ssssrrrr  sustain, release
+//
+// followed by the global filter bytes
+//
+//   cutoff      -ccccccc  cutoff
+//   res_mode    rrrr--mm  resonance, filter mode
+//
+// and the modulation routes, one byte per voice for each source
+//
+//   velocity    dddd-rrr  depth, destination (x3)
+//   pressure    dddd-rrr  depth, destination (x3)
+
+static constexpr uint8_t Voice_frequency  = 0;
+static constexpr uint8_t Voice_pulsewidth = 1;
+static constexpr uint8_t Voice_control    = 2;
+static constexpr uint8_t Voice_ad         = 3;
+static constexpr uint8_t Voice_sr         = 4;
+static constexpr uint8_t Voice_size       = 5;
+
+static constexpr uint8_t Patch_cutoff     = Voice_size * 3;
+static constexpr uint8_t Patch_res_mode   = Patch_cutoff + 1;
+static constexpr uint8_t Patch_velocity   = Patch_res_mode + 1;
+static constexpr uint8_t Patch_pressure   = Patch_velocity + 3;
+static constexpr uint8_t Patch_size       = Patch_pressure + 3;
+
+struct Patch
+{
+  inline uint8_t get (uint8_t offset, uint8_t bit, uint8_t width) const
+  {
+    return (data[offset] >> bit) & ((1 << width) - 1);
+  }
+
+  inline void set (uint8_t offset, uint8_t bit, uint8_t width, uint8_t value)
+  {
+    uint8_t mask = ((1 << width) - 1) << bit;
+    data[offset] = (data[offset] & ~ mask) | ((value << bit) & mask);
+  }
+
+  inline bool operator== (const Patch & other) const
+  {
+    return memcmp (data, other.data, Patch_size) == 0;
+  }
+
+  inline bool operator!= (const Patch & other) const
+  {
+    return ! (*this == other);
+  }
+
+  uint8_t data[Patch_size];
+};
+
+const Patch default_patch PROGMEM =
+{{
+  5, 64, 0x00, 0x08, 0xf8,
+  5, 64, 0x00, 0x08, 0xf8,
+  5, 64, 0x00, 0x08, 0xf8,
+  127, 0x00,
+  0x00, 0x00, 0x00,
+  0x00, 0x00, 0x00,
+}};
+
+#endif /* _PATCH_H */
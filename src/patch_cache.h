@@ -0,0 +1,95 @@
+#ifndef _PATCH_CACHE_H
+#define _PATCH_CACHE_H
+
+#include "sid.h"
+#include "patch.h"
+#include "parameters.h"
+#include "cc_map.h"
+
+static constexpr uint8_t Num_cached    = 3;
+static constexpr uint8_t No_program    = 0xff;
+static constexpr uint8_t Master_volume = 0x0f;
+
+// SID register file decoded from a patch, built with the same
+// apply_parameter path as live edits.
+struct Register_image
+{
+  void set_bits (uint8_t reg, uint8_t mask, uint8_t bits)
+  {
+    regs[reg] = (regs[reg] & ~ mask) | (bits & mask);
+  }
+
+  void decode (const Patch & patch)
+  {
+    memset (regs, 0, sizeof (regs));
+    set_bits (Filter_mode_vol, 0x0f, Master_volume);
+    apply_patch (*this, patch);
+  }
+
+  uint8_t regs[Last_register];
+};
+
+// A few recently used or prefetched programs kept decoded in RAM, with
+// their controller bindings, so a program change is a register image swap
+// instead of an EEPROM read and a parameter by parameter decode.
+class Patch_cache
+{
+  public:
+    struct Entry
+    {
+      uint8_t        program;
+      Patch          patch;
+      Cc_bindings    controls;
+      Register_image image;
+    };
+
+    Patch_cache ()
+      : _next (0)
+    {
+      for (auto & e : _entries)
+        e.program = No_program;
+    }
+
+    Entry * find (uint8_t program)
+    {
+      for (auto & e : _entries)
+      {
+        if (e.program == program)
+          return & e;
+      }
+
+      return nullptr;
+    }
+
+    Entry & insert (uint8_t program, const Patch & patch, const Cc_bindings & controls)
+    {
+      auto e = find (program);
+
+      if (!e)
+      {
+        e = & _entries[_next];
+        _next = (_next + 1) % Num_cached;
+      }
+
+      e->program  = program;
+      e->patch    = patch;
+      e->controls = controls;
+      e->image.decode (patch);
+      return *e;
+    }
+
+    void invalidate (uint8_t program)
+    {
+      auto e = find (program);
+
+      if (e)
+        e->program = No_program;
+    }
+
+  private:
+
+    Entry   _entries[Num_cached];
+    uint8_t _next;
+};
+
+#endif /* _PATCH_CACHE_H */
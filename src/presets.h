@@ -0,0 +1,45 @@
+#ifndef _PRESETS_H
+#define _PRESETS_H
+
+#include <avr/pgmspace.h>
+#include "patch.h"
+#include "bank.h"
+
+struct Preset
+{
+  char  name[5];
+  Patch patch;
+};
+
+// Factory sounds in the packed patch format. They follow the user bank in
+// program numbering and are read straight from flash.
+const Preset presets[] PROGMEM =
+{
+  //        freq  pw  ctrl    ad    sr  (x3)                  cutoff res_mode  velocity pressure (x3)
+  { "BASS", {{ 5, 64, 0x12, 0x09, 0x84,
+               5, 64, 0x12, 0x09, 0x84,
+               5, 64, 0x12, 0x09, 0x84,  40, 0xa0, 0, 0, 0,  0, 0, 0 }} },
+  { "LEAD", {{ 5, 32, 0x20, 0x05, 0xa6,
+               5, 32, 0x20, 0x05, 0xa6,
+               5, 32, 0x20, 0x05, 0xa6, 127, 0x00, 0, 0, 0,  0, 0, 0 }} },
+  { "PAD",  {{ 5, 64, 0x02, 0x88, 0xca,
+               5, 64, 0x02, 0x88, 0xca,
+               5, 64, 0x02, 0x88, 0xca,  70, 0x41, 0, 0, 0,  0, 0, 0 }} },
+  { "BRAS", {{ 5, 64, 0x12, 0x46, 0xa5,
+               5, 64, 0x12, 0x46, 0xa5,
+               5, 64, 0x12, 0x46, 0xa5,  60, 0x60, 0, 0, 0,  0, 0, 0 }} },
+  { "ORGN", {{ 5, 64, 0x20, 0x00, 0xf2,
+               5, 64, 0x20, 0x00, 0xf2,
+               5, 64, 0x20, 0x00, 0xf2, 127, 0x00, 0, 0, 0,  0, 0, 0 }} },
+  { "PERC", {{ 5, 64, 0x30, 0x04, 0x03,
+               5, 64, 0x30, 0x04, 0x03,
+               5, 64, 0x30, 0x04, 0x03, 100, 0x22, 0, 0, 0,  0, 0, 0 }} },
+  { "SPLT", {{ 5, 64, 0x12, 0x09, 0x84,
+               5, 32, 0x20, 0x05, 0xa6,
+               5, 64, 0x02, 0x88, 0xca,  80, 0x40, 0, 0, 0,  0, 0, 0 }} },
+};
+
+static constexpr uint8_t Num_presets  = sizeof (presets) / sizeof (presets[0]);
+static constexpr uint8_t Num_programs = Num_patches + Num_presets;
+
+#endif /* _PRESETS_H */
@@ -0,0 +1,187 @@
+#ifndef _PROFILE_H
+#define _PROFILE_H
+
+#include <stdint.h>
+
+// Hot path probes. Add new ones before Num_probes.
+enum Probe
+{
+  Probe_note_on = 0,  // MIDI note on up to the last SID write
+  Probe_sid_update,
+  Probe_render,
+  Probe_save,         // Settings::save, from the menu or the switch
+  Probe_timer_isr,
+  Probe_pcint_isr,
+  Probe_uart_isr,
+  Probe_eeprom_isr,
+
+  Num_probes,
+};
+
+#ifdef PROFILE
+
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <util/atomic.h>
+
+// Timer1 clocks the SID, so the profiler runs Timer2 free at F_CPU / 8
+// and counts overflows in software. One count is 8 cycles and a section
+// can be up to 65535 counts (~32 ms) long.
+static constexpr uint8_t Profile_cycles_per_count = 8;
+
+struct Probe_stats
+{
+  uint16_t min;    // counts
+  uint16_t max;    // counts
+  uint32_t sum;    // counts
+  uint16_t runs;
+};
+
+// Kept outside the profiler under a fixed name so it can be read from a
+// debugger or simulator without knowing the class layout.
+Probe_stats profile_stats[Num_probes];
+
+class Profiler
+{
+  public:
+    Profiler ()
+      : _overflows (0)
+    {
+      reset ();
+    }
+
+    void init ()
+    {
+      TCCR2A = 0;
+      TCCR2B = _BV (CS21);
+      TIMSK2 = _BV (TOIE2);
+    }
+
+    // Called from interrupt
+    void overflow ()
+    {
+      _overflows++;
+    }
+
+    uint16_t now () const
+    {
+      uint8_t high;
+      uint8_t count;
+
+      ATOMIC_BLOCK (ATOMIC_RESTORESTATE)
+      {
+        high = _overflows;
+        count = TCNT2;
+
+        if ((TIFR2 & _BV (TOV2)) && count < 0x80)
+          high++;
+      }
+
+      return (uint16_t) high << 8 | count;
+    }
+
+    void record (uint8_t probe, uint16_t counts)
+    {
+      auto & s = profile_stats[probe];
+
+      ATOMIC_BLOCK (ATOMIC_RESTORESTATE)
+      {
+        if (counts < s.min)
+          s.min = counts;
+
+        if (counts > s.max)
+          s.max = counts;
+
+        // Halve the history rather than let the average overflow
+        if (s.runs == 0xffff)
+        {
+          s.sum >>= 1;
+          s.runs >>= 1;
+        }
+
+        s.sum += counts;
+        s.runs++;
+      }
+    }
+
+    void reset ()
+    {
+      ATOMIC_BLOCK (ATOMIC_RESTORESTATE)
+      {
+        for (auto & s : profile_stats)
+        {
+          s = { 0xffff, 0, 0, 0 };
+        }
+      }
+    }
+
+    // Cycle counts for display, 0 for probes that have not run
+    static uint32_t min (uint8_t probe)
+    {
+      auto s = get (probe);
+      return s.runs ? (uint32_t) s.min * Profile_cycles_per_count : 0;
+    }
+
+    static uint32_t max (uint8_t probe)
+    {
+      return (uint32_t) get (probe).max * Profile_cycles_per_count;
+    }
+
+    static uint32_t avg (uint8_t probe)
+    {
+      auto s = get (probe);
+      return s.runs ? s.sum / s.runs * Profile_cycles_per_count : 0;
+    }
+
+  private:
+
+    static Probe_stats get (uint8_t probe)
+    {
+      Probe_stats s;
+
+      ATOMIC_BLOCK (ATOMIC_RESTORESTATE)
+      {
+        s = profile_stats[probe];
+      }
+
+      return s;
+    }
+
+    volatile uint8_t _overflows;
+};
+
+Profiler _profiler;
+
+class Profile_scope
+{
+  public:
+    Profile_scope (uint8_t probe)
+      : _probe (probe)
+      , _start (_profiler.now ())
+    {
+    }
+
+    ~Profile_scope ()
+    {
+      _profiler.record (_probe, _profiler.now () - _start);
+    }
+
+  private:
+    uint8_t  _probe;
+    uint16_t _start;
+};
+
+ISR(TIMER2_OVF_vect)
+{
+  _profiler.overflow ();
+}
+
+#define PROFILE_SCOPE(probe) Profile_scope _profile_scope (probe)
+
+#else
+
+#define PROFILE_SCOPE(probe)
+
+#endif /* PROFILE */
+
+#endif /* _PROFILE_H */
@@ -20,7 +20,12 @@ class RingBuffer
 
   inline bool full () const
   {
-    return (_write_pos - _read_pos) == (Size - 1);
+    return count () == (Size - 1);
+  }
+
+  inline uint8_t count () const
+  {
+    return (_write_pos - _read_pos) & (Size - 1);
   }
 
   inline void write (T data)
@@ -0,0 +1,166 @@
+#ifndef _SCHEDULER_H
+#define _SCHEDULER_H
+
+#include <avr/pgmspace.h>
+#include <util/atomic.h>
+#include <stdint.h>
+#include "clock.h"
+
+static constexpr uint8_t  Max_tasks          = 6;
+static constexpr uint16_t Min_frame_rate     = 50;
+static constexpr uint16_t Max_frame_rate     = 1000;
+static constexpr uint16_t Default_frame_rate = 250;
+
+// Timer0 ticks per second (F_CPU / 256 / 64)
+static constexpr uint16_t Clock_rate = F_CPU / 256 / Clock_counts;
+
+// Frames are a whole number of ticks, so only some rates can be had
+static constexpr uint8_t Min_frame_ticks = (Clock_rate + Max_frame_rate / 2) / Max_frame_rate;
+static constexpr uint8_t Max_frame_ticks = (Clock_rate + Min_frame_rate / 2) / Min_frame_rate;
+
+static_assert (Min_frame_ticks > 0, "frames shorter than a tick");
+
+struct Task
+{
+  void    (*run) ();
+  uint8_t budget;  // clock counts (16 us)
+};
+
+// Cooperative scheduler. Slot 0 is the highest priority and runs on every
+// pass of the main loop as well as between the other slots. The remaining
+// slots run once per control frame in table order. Each run is timed
+// against its budget; runs that exceed it are counted as overruns, and
+// frames that start late because the previous one ran long are counted
+// separately.
+class Scheduler
+{
+  public:
+    template<uint8_t N>
+    Scheduler (const Task (&tasks)[N], uint16_t frame_rate)
+      : _tasks (tasks)
+      , _num_tasks (N)
+      , _elapsed (0)
+      , _late_frames (0)
+      , _max {}
+      , _overruns {}
+    {
+      static_assert (N <= Max_tasks, "too many tasks");
+      set_frame_rate (frame_rate);
+    }
+
+    // Rate achieved with the whole number of ticks per frame
+    uint16_t frame_rate () const
+    {
+      return Clock_rate / _frame_ticks;
+    }
+
+    // Nearest rate that can be had, within the limits
+    void set_frame_rate (uint16_t frame_rate)
+    {
+      if (frame_rate < Min_frame_rate)
+        frame_rate = Min_frame_rate;
+
+      if (frame_rate > Max_frame_rate)
+        frame_rate = Max_frame_rate;
+
+      _frame_ticks = (Clock_rate + frame_rate / 2) / frame_rate;
+    }
+
+    uint8_t frame_ticks () const
+    {
+      return _frame_ticks;
+    }
+
+    void set_frame_ticks (int16_t ticks)
+    {
+      _frame_ticks = ticks < Min_frame_ticks ? Min_frame_ticks : ticks > Max_frame_ticks ? Max_frame_ticks : ticks;
+    }
+
+    // Called from timer interrupt
+    void tick ()
+    {
+      if (_elapsed < 0xff)
+        _elapsed++;
+    }
+
+    void run ()
+    {
+      run_task (0);
+
+      if (!frame_due ())
+        return;
+
+      for (uint8_t i = 1; i < _num_tasks; ++i)
+      {
+        run_task (i);
+        run_task (0);
+      }
+    }
+
+    uint8_t max (uint8_t slot) const
+    {
+      return _max[slot];
+    }
+
+    uint8_t overruns (uint8_t slot) const
+    {
+      return _overruns[slot];
+    }
+
+    uint8_t late_frames () const
+    {
+      return _late_frames;
+    }
+
+  private:
+
+    bool frame_due ()
+    {
+      uint8_t elapsed;
+
+      ATOMIC_BLOCK (ATOMIC_RESTORESTATE)
+      {
+        elapsed = _elapsed;
+
+        if (elapsed >= _frame_ticks)
+          _elapsed = 0;
+      }
+
+      if (elapsed < _frame_ticks)
+        return false;
+
+      if (elapsed >= 2 * _frame_ticks && _late_frames < 0xff)
+        _late_frames++;
+
+      return true;
+    }
+
+    void run_task (uint8_t slot)
+    {
+      Task task;
+      memcpy_P (& task, & _tasks[slot], sizeof (task));
+
+      uint16_t start = _clock.now ();
+      task.run ();
+      uint16_t time = _clock.now () - start;
+
+      if (time > 0xff)
+        time = 0xff;
+
+      if (time > _max[slot])
+        _max[slot] = time;
+
+      if (time > task.budget && _overruns[slot] < 0xff)
+        _overruns[slot]++;
+    }
+
+    const Task *      _tasks;
+    uint8_t           _num_tasks;
+    uint8_t           _frame_ticks;
+    volatile uint8_t  _elapsed;
+    uint8_t           _late_frames;
+    uint8_t           _max[Max_tasks];
+    uint8_t           _overruns[Max_tasks];
+};
+
+#endif /* _SCHEDULER_H */
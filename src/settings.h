@@ -2,251 +2,210 @@
 #define _SETTINGS_H
 
 #include <avr/eeprom.h>
+#include "parameters.h"
+#include "patch.h"
+#include "bank.h"
+#include "cc_map.h"
+#include "presets.h"
+#include "profile.h"
 
-uint16_t EEMEM eeprom_settings[30];
-
-enum Setting
+class Settings
 {
-  VOICE_FREQUENCY = 0,
-  VOICE_SHAPE,
-  VOICE_PW,
-  VOICE_ATTACK,
-  VOICE_DECAY,
-  VOICE_SUSTAIN,
-  VOICE_RELEASE,
-  VOICE_GATE,
-  VOICE_FILTER,
-  
-  FILTER_CUTOFF,
-  FILTER_RESONANCE,
-  FILTER_MODE,
-};
+  public:
+    Settings ()
+      : _program (0)
+      , _pending (No_slot)
+    {
+      memcpy_P (& _patch, & default_patch, sizeof (_patch));
+    }
 
-Setting & operator++ (Setting & s)
-{
-  s = static_cast<Setting> (static_cast<int8_t> (s) + 1);
-  return s;
-}
+    ~Settings ()
+    {
+    }
 
-namespace
-{
+    void set (Setting setting, uint8_t voice, int16_t v)
+    {
+      auto p = get_parameter (setting);
 
-bool max_15 (int16_t n)
-{
-  return (n >= 0 && n < 16);
-}
+      if (v >= 0 && v <= p.max)
+        set_value (_patch, p, voice, v);
+    }
 
-bool max_127 (int16_t n)
-{
-  return (n >= 0 && n < 128);
-}
+    int16_t get (Setting setting, uint8_t voice)
+    {
+      return get_value (_patch, get_parameter (setting), voice);
+    }
 
-}
+    const Patch & patch () const
+    {
+      return _patch;
+    }
 
-class Settings
-{
-  public:
-    Settings ()
-      : _frequency {5, 5, 5}
-      , _shape {0, 0, 0}
-      , _pw {64, 64, 64}
-      , _attack {0, 0, 0}
-      , _decay {8, 8, 8}
-      , _sustain {15, 15, 15}
-      , _release {8, 8, 8}
-      , _gate {0, 0, 0}
-      , _filter_enable {0, 0, 0}
-      , _cutoff (127)
-      , _resonance (0)
-      , _filter_mode (0)
+    uint8_t program () const
     {
+      return _program;
     }
 
-    ~Settings ()
+    // Controller bindings of the current program
+    Cc_map & controls ()
     {
+      return _controls;
     }
 
-    void set (Setting setting, uint8_t voice, int16_t v)
+    bool save ()
     {
-      switch (setting)
+      PROFILE_SCOPE (Probe_save);
+
+      if (_program >= Num_patches)
+        return false;
+
+      return _bank.save (_program, _patch, _controls.bindings ());
+    }
+
+    bool saving () const
+    {
+      return _bank.busy () || _pending != No_slot;
+    }
+
+    // Queues a patch for a bank program without selecting it, keeping the
+    // program's stored controller bindings. One patch can wait for the
+    // bank while another is being written; returns false if one is
+    // already waiting.
+    bool store (uint8_t program, const Patch & patch)
+    {
+      if (program >= Num_patches || _pending != No_slot)
+        return false;
+
+      _pending = program;
+      _pending_patch = patch;
+      poll ();
+      return true;
+    }
+
+    // Returns true once when the last save has completed
+    bool poll ()
+    {
+      bool done = _bank.poll ();
+
+      if (_pending != No_slot && !_bank.busy ())
       {
-        case VOICE_FREQUENCY:
-          if (max_127 (v))
-            _frequency[voice] = v;
-          break;
-        case VOICE_SHAPE:
-          if (v >= 0 && v <=3)
-            _shape[voice] = v;
-          break;
- 
-        case VOICE_PW:
-          if (max_127 (v))
-            _pw[voice] = v;
-          break;
-
-        case VOICE_ATTACK:
-          if (max_15 (v))
-            _attack[voice] = v;
-          break;
-
-        case VOICE_DECAY:
-          if (max_15 (v))
-            _decay[voice] = v;
-          break;
-
-        case VOICE_SUSTAIN:
-          if (max_15 (v))
-            _sustain[voice] = v;
-          break;
-
-        case VOICE_RELEASE:
-          if (max_15 (v))
-            _release[voice] = v;
-          break;
-
-        case VOICE_GATE:
-          if (v >= 0 && v < 2)
-            _gate[voice] = v;
-          break;
- 
-        case VOICE_FILTER:
-          if (v >= 0 && v < 2)
-            _filter_enable[voice] = v;
-          break;
-
-        case FILTER_CUTOFF:
-          if (max_127 (v))
-            _cutoff = v; 
-          break;
-
-        case FILTER_RESONANCE:
-          if (max_15 (v))
-            _resonance = v;
-          break;
-
-        case FILTER_MODE:
-          if (v >= 0 && v <=2)
-            _filter_mode = v; 
-          break;
+        Cc_bindings controls;
+        read (_pending, controls);
+
+        if (_bank.save (_pending, _pending_patch, controls))
+          _pending = No_slot;
       }
+
+      return done;
     }
 
-    int16_t get (Setting setting, uint8_t voice)
+    void init ()
     {
-      int16_t ret = 0;
-  
-      switch (setting)
+      _bank.init ();
+      select (0);
+    }
+
+    // Reads a program from the bank, or the factory default patch if no
+    // valid record is stored for it. Out of range values are replaced by
+    // the default. Programs after the bank are factory presets.
+    void read (uint8_t program, Patch & patch)
+    {
+      Patch stored;
+
+      if (program >= Num_patches)
       {
-        case VOICE_FREQUENCY:
-          ret = _frequency[voice];
-          break;
-
-        case VOICE_SHAPE:
-          ret = _shape[voice];
-          break;
- 
-        case VOICE_PW:
-          ret = _pw[voice];
-          break; 
-
-        case VOICE_ATTACK:
-          ret = _attack[voice];
-          break;
-
-        case VOICE_DECAY:
-          ret = _decay[voice];
-          break;
-
-        case VOICE_SUSTAIN:
-          ret = _sustain[voice];
-          break;
-
-        case VOICE_RELEASE:
-          ret = _release[voice];
-          break;
-
-        case VOICE_GATE:
-          ret = _gate[voice];
-          break;
- 
-        case VOICE_FILTER:
-          ret = _filter_enable[voice];
-          break;
- 
-        case FILTER_CUTOFF:
-          ret = _cutoff;
-          break;
- 
-        case FILTER_RESONANCE:
-          ret = _resonance;
-          break;
- 
-        case FILTER_MODE:
-          ret = _filter_mode;
-          break; 
+        memcpy_P (& patch, & presets[program - Num_patches].patch, sizeof (patch));
+        return;
       }
 
-      return ret;
+      if (_bank.load (program, stored))
+      {
+        sanitize (stored, patch);
+      }
+
+      else
+      {
+        memcpy_P (& patch, & default_patch, sizeof (patch));
+      }
     }
 
-    void save ()
+    // Controller bindings stored with a program. Factory presets and
+    // programs stored without a valid record get the default bindings.
+    void read (uint8_t program, Cc_bindings & controls)
     {
-      uint8_t e_idx = 0;
+      if (program >= Num_patches || !_bank.load (program, controls))
+        memcpy_P (& controls, & default_cc_bindings, sizeof (controls));
+    }
+
+    // Both from one read of the record
+    void read (uint8_t program, Patch & patch, Cc_bindings & controls)
+    {
+      Patch stored;
 
-      for (uint8_t i = 0; i < 3; ++i)
+      if (program < Num_patches && _bank.load (program, stored, controls))
       {
-        eeprom_write_word (& eeprom_settings[e_idx++], (uint16_t) _frequency[i]);
-        eeprom_write_word (& eeprom_settings[e_idx++], (uint16_t) _shape[i]);
-        eeprom_write_word (& eeprom_settings[e_idx++], (uint16_t) _pw[i]);
-        eeprom_write_word (& eeprom_settings[e_idx++], (uint16_t) _attack[i]);
-        eeprom_write_word (& eeprom_settings[e_idx++], (uint16_t) _decay[i]);
-        eeprom_write_word (& eeprom_settings[e_idx++], (uint16_t) _sustain[i]);
-        eeprom_write_word (& eeprom_settings[e_idx++], (uint16_t) _release[i]);
-        eeprom_write_word (& eeprom_settings[e_idx++], (uint16_t) _gate[i]);
-        eeprom_write_word (& eeprom_settings[e_idx++], (uint16_t) _filter_enable[i]);
+        sanitize (stored, patch);
+        return;
       }
-        eeprom_write_word (& eeprom_settings[e_idx++], (uint16_t) _cutoff);
-        eeprom_write_word (& eeprom_settings[e_idx++], (uint16_t) _resonance);
-        eeprom_write_word (& eeprom_settings[e_idx++], (uint16_t) _filter_mode);
-    }
-
-    void load ()
-    {
-      uint8_t e_idx = 0;
-
-      for (uint8_t i = 0; i < 3; ++i)
-      { 
-        set (VOICE_FREQUENCY, i, (int16_t) eeprom_read_word(& eeprom_settings[e_idx++]));
-        set (VOICE_SHAPE,     i, (int16_t) eeprom_read_word(& eeprom_settings[e_idx++]));
-        set (VOICE_PW,        i, (int16_t) eeprom_read_word(& eeprom_settings[e_idx++]));
-        set (VOICE_ATTACK,    i, (int16_t) eeprom_read_word(& eeprom_settings[e_idx++]));
-        set (VOICE_DECAY,     i, (int16_t) eeprom_read_word(& eeprom_settings[e_idx++]));
-        set (VOICE_SUSTAIN,   i, (int16_t) eeprom_read_word(& eeprom_settings[e_idx++]));
-        set (VOICE_RELEASE,   i, (int16_t) eeprom_read_word(& eeprom_settings[e_idx++]));
-        set (VOICE_GATE,      i, (int16_t) eeprom_read_word(& eeprom_settings[e_idx++]));
-        set (VOICE_FILTER,    i, (int16_t) eeprom_read_word(& eeprom_settings[e_idx++]));
+
+      read (program, patch);
+      memcpy_P (& controls, & default_cc_bindings, sizeof (controls));
+    }
+
+    // Copies a patch from outside, replacing out of range values by the
+    // default
+    static void sanitize (const Patch & stored, Patch & patch)
+    {
+      memcpy_P (& patch, & default_patch, sizeof (patch));
+
+      for (Setting s = VOICE_FREQUENCY; s < Num_settings; ++s)
+      {
+        auto p = get_parameter (s);
+
+        for (uint8_t voice = 0; voice < get_voices (p); ++voice)
+        {
+          auto v = get_value (stored, p, voice);
+
+          if (v <= p.max)
+            set_value (patch, p, voice, v);
+        }
       }
+    }
+
+    void select (uint8_t program, const Patch & patch, const Cc_bindings & controls)
+    {
+      _controls.load (controls);
+      _program = program;
+      _patch = patch;
+    }
 
-      set (FILTER_CUTOFF, 0, (int16_t) eeprom_read_word(& eeprom_settings[e_idx++]));
-      set (FILTER_RESONANCE, 0, (int16_t) eeprom_read_word(& eeprom_settings[e_idx++]));
-      set (FILTER_MODE, 0, (int16_t) eeprom_read_word(& eeprom_settings[e_idx++]));
+    // Replaces the sound of the current program, keeping its controller
+    // bindings
+    void edit (const Patch & patch)
+    {
+      _patch = patch;
     }
 
-  private:
+    void select (uint8_t program)
+    {
+      Patch       patch;
+      Cc_bindings controls;
 
-    int16_t _frequency[3];
-    int16_t _shape[3];
-    int16_t _pw[3];
-    int16_t _attack[3];
-    int16_t _decay[3];
-    int16_t _sustain[3];
-    int16_t _release[3];
-    int16_t _gate[3];
-    int16_t _filter_enable[3];
-    int16_t _cutoff;
-    int16_t _resonance;
-    int16_t _filter_mode;
+      if (program >= Num_programs)
+        return;
+
+      read (program, patch, controls);
+      select (program, patch, controls);
+    }
+
+  private:
 
+    Bank    _bank;
+    Patch   _patch;
+    Cc_map  _controls;
+    uint8_t _program;
+    uint8_t _pending;
+    Patch   _pending_patch;
 };
 
 #endif /* _SETTINGS_H */
@@ -6,11 +6,18 @@
 #include <stdio.h>
 #include "oled.h"
 #include "sid.h"
+#include "sid_bus.h"
 #include "ui.h"
 #include "uart.h"
 #include "midi.h"
 #include "menu.h"
 #include "settings.h"
+#include "engine.h"
+#include "clock.h"
+#include "scheduler.h"
+#include "profile.h"
+#include "stack.h"
+#include "stream.h"
    
 /* ---------- PIN CONFIGURATION ----------
  *
@@ -43,12 +50,8 @@
  * ------------------------------------ */
 
 const uint8_t midi_rx     = PD0;
-const uint8_t hc595_data  = PD1;
-const uint8_t hc595_clk   = PD2;
-const uint8_t hc595_latch = PD3;
 
 const uint8_t sid_clk     = PB1;
-const uint8_t sid_cs      = PD6;
 const uint8_t sid_rw      = PD7;
  
 const uint8_t spi_mosi    = PB3;
@@ -64,158 +67,141 @@ const uint8_t sw1         = PC4;
 const uint8_t sw2         = PC5;
 const uint8_t sw3         = PB0;
 
-const uint16_t notes[] PROGMEM = 
-{
-  291, 308, 326, 346, 366, 388, 411, 435, 461, 489, 518, 549, 
-  581, 616, 652, 691, 732, 776, 822, 871, 923, 978, 1036,1097,
-  1163, 1232, 1305, 1383, 1465, 1552, 1644, 1742, 1845, 1955, 2071, 2195,
-  2325, 2463, 2610, 2765, 2930, 3104, 3288, 3484, 3691, 3910, 4143, 4650,
-  4927, 5220, 5530, 5859, 6207, 6577, 6968, 7382, 7821, 8286, 8779, 9301,
-  9854, 10440, 11060, 11718, 12415, 13153, 13935, 14764, 15642, 16572, 17557, 18601,
-  19709, 20897, 22121, 23436, 24830, 26306, 27871, 29528, 31234, 33144, 35115, 37203,
-  39415, 41759, 44242, 46873, 49660, 52613, 55741, 59056, 62567,
-};
-
 namespace strings
 {
   const char voice1     [] PROGMEM = "VOICE 1";
   const char voice2     [] PROGMEM = "VOICE 2";
   const char voice3     [] PROGMEM = "VOICE 3";
-  const char attack     [] PROGMEM = "ATTACK";
-  const char decay      [] PROGMEM = "DECAY";
-  const char sustain    [] PROGMEM = "SUSTAIN";
-  const char release    [] PROGMEM = "RELEASE";
-  const char frequency  [] PROGMEM = "FREQ";
-  const char shape      [] PROGMEM = "SHAPE";
-  const char gate       [] PROGMEM = "GATE";
-  const char pulsewidth [] PROGMEM = "PW";
-  const char tri        [] PROGMEM = "TRI";
-  const char saw        [] PROGMEM = "SAW";
-  const char squ        [] PROGMEM = "SQU";
-  const char noise      [] PROGMEM = "NOI";
-  const char filter     [] PROGMEM = "FILTER";
   const char mark       [] PROGMEM = ">";
-  const char resonance  [] PROGMEM = "RES";
-  const char cutoff     [] PROGMEM = "CUTOFF";
-  const char type       [] PROGMEM = "TYPE";
-  const char lp         [] PROGMEM = "LP";
-  const char bp         [] PROGMEM = "BP";
-  const char hp         [] PROGMEM = "HP";
+  const char patch      [] PROGMEM = "PATCH";
+  const char program    [] PROGMEM = "PROGRAM";
+  const char save       [] PROGMEM = "SAVE";
+  const char busy       [] PROGMEM = "BUSY";
+  const char latency    [] PROGMEM = "LAT US";
+  const char morph      [] PROGMEM = "MORPH";
+  const char enable     [] PROGMEM = "ENABLE";
+  const char on         [] PROGMEM = "ON";
+  const char patch_a    [] PROGMEM = "PATCH A";
+  const char patch_b    [] PROGMEM = "PATCH B";
+  const char position   [] PROGMEM = "POS";
+  const char diag       [] PROGMEM = "DIAG";
+  const char frame_hz   [] PROGMEM = "FRAME HZ";
+  const char late       [] PROGMEM = "LATE FRAMES";
+  const char ovr_midi   [] PROGMEM = "OVR MIDI";
+  const char ovr_mod    [] PROGMEM = "OVR MOD";
+  const char ovr_sid    [] PROGMEM = "OVR SID";
+  const char ovr_ui     [] PROGMEM = "OVR UI";
+  const char ovr_draw   [] PROGMEM = "OVR DRAW";
+  const char rx_drop    [] PROGMEM = "RX DROPPED";
+  const char rx_overrun [] PROGMEM = "RX OVERRUN";
+  const char rx_peak    [] PROGMEM = "RX PEAK";
+  const char sysex_in   [] PROGMEM = "SYSEX IN";
+  const char sysex_err  [] PROGMEM = "SYSEX ERR";
+  const char learn      [] PROGMEM = "CC?";
+  const char stream     [] PROGMEM = "STREAM";
+  const char input      [] PROGMEM = "INPUT";
+  const char in_midi    [] PROGMEM = "MIDI";
+  const char in_slow    [] PROGMEM = "31K";
+#if UART_BUFFER_SIZE >= 128
+  const char in_fast    [] PROGMEM = "250K";
+#endif
+  const char frames     [] PROGMEM = "FRAMES";
+  const char lost       [] PROGMEM = "LOST";
+  const char errors     [] PROGMEM = "ERRORS";
+  const char underruns  [] PROGMEM = "UNDERRUNS";
+  const char ram        [] PROGMEM = "RAM";
+  const char stack_free [] PROGMEM = "STACK FREE";
+  const char stack_peak [] PROGMEM = "STACK PEAK";
+  const char ram_static [] PROGMEM = "STATIC";
+  const char ram_sid    [] PROGMEM = "SID";
+  const char ram_set    [] PROGMEM = "SETTINGS";
+  const char ram_cache  [] PROGMEM = "CACHE";
+  const char ram_morph  [] PROGMEM = "MORPH";
+  const char ram_mod    [] PROGMEM = "MODULATION";
+  const char ram_menu   [] PROGMEM = "MENU";
+  const char ram_ui     [] PROGMEM = "UI";
+  const char ram_midi   [] PROGMEM = "MIDI";
+  const char ram_rx     [] PROGMEM = "RX BUFFER";
+  const char ram_stream [] PROGMEM = "STREAM";
+  const char ram_sysex  [] PROGMEM = "SYSEX";
+  const char ram_sched  [] PROGMEM = "SCHEDULER";
+#ifdef PROFILE
+  const char prof       [] PROGMEM = "PROFILE";
+  const char view       [] PROGMEM = "CYCLES";
+  const char reset      [] PROGMEM = "RESET";
+  const char min        [] PROGMEM = "MIN";
+  const char avg        [] PROGMEM = "AVG";
+  const char max        [] PROGMEM = "MAX";
+  const char prof_note  [] PROGMEM = "NOTE ON";
+  const char prof_sid   [] PROGMEM = "SID UPDATE";
+  const char prof_draw  [] PROGMEM = "RENDER";
+  const char prof_save  [] PROGMEM = "SAVE";
+  const char prof_t0    [] PROGMEM = "TIMER ISR";
+  const char prof_pc    [] PROGMEM = "ENC ISR";
+  const char prof_rx    [] PROGMEM = "UART ISR";
+  const char prof_ee    [] PROGMEM = "EEPROM ISR";
+#endif
 }
 
-struct SidHandler
-{
-  static void write (uint8_t address, uint8_t data)
-  {
-    bit::clear (PORTD, hc595_clk);
-    bit::clear (PORTD, hc595_latch);
-
-    bit::set (PORTD, sid_cs);
-
-    for (int i = 7; i >= 0; --i)
-    {
-      if (data & _BV (i))
-      {
-        bit::set (PORTD, hc595_data);
-      }
-
-      else
-      {
-        bit::clear (PORTD, hc595_data);
-      }
-
-      bit::set (PORTD, hc595_clk);
-      bit::clear (PORTD, hc595_clk);
-    }
+Oled<Oled_spi> _oled;
 
-    for (int i = 7; i >= 0; --i)
-    {
-      if (address & _BV (i))
-      {
-        bit::set (PORTD, hc595_data);
-      }
-
-      else
-      {
-        bit::clear (PORTD, hc595_data);
-      }
-
-      bit::set (PORTD, hc595_clk);
-      bit::clear (PORTD, hc595_clk);
-    }
+typedef Engine<SidHandler> Synth;
 
-    bit::set (PORTD, hc595_latch);
-    bit::clear (PORTD, sid_cs);
-    _delay_us (4);
-    bit::set (PORTD, sid_cs);
-  }
-};
+Sid<SidHandler> & _sid      = Synth::sid;
+Settings &        _settings = Synth::settings;
 
-Oled _oled;
-Sid<SidHandler> _sid;
-Settings _settings;
+Uart _serial;
+Register_stream<> _stream (_serial);
 
-struct MidiHandler
+// What arrives on the serial input: MIDI, or register stream frames at
+// the MIDI rate (through the MIDI input) or at 250000 baud. A display
+// redraw overflows the default receive ring at 250000 baud, so that mode
+// is only offered with the larger ring of make stream.
+enum Input
 {
-  static void note_on (uint8_t channel, uint8_t note)
-  {
-    uint8_t voice = 0;
-
-    switch (channel)
-    {
-      case 0:
-        voice = 0;
-        break;
-
-      case 1:
-        voice = 1;
-        break;
+  Input_midi = 0,
+  Input_stream_slow,
+#if UART_BUFFER_SIZE >= 128
+  Input_stream_fast,
+#endif
 
-      case 2:
-        voice = 2;
-        break;
+  Num_inputs,
+};
 
-      default:
-        break;
-    }
-    _sid.set_frequency (voice, pgm_read_word (& notes[note]));
-    _sid.gate (voice, true);
-    _sid.update ();
-  }
+uint8_t _input = Input_midi;
 
-  static void note_off (uint8_t channel)
-  {
-    uint8_t voice = 0;
+void set_input (uint8_t mode);
+void drain_midi ();
+void run_modulation ();
+void flush_sid ();
+void update_ui ();
+void render_ui ();
 
-    switch (channel)
-    {
-      case 0:
-        voice = 0;
-        break;
+enum Task_slot
+{
+  Task_midi = 0,
+  Task_modulation,
+  Task_sid,
+  Task_ui,
+  Task_render,
+};
 
-      case 1:
-        voice = 1;
-        break;
+static constexpr uint8_t Midi_budget = 8;
 
-      case 2:
-        voice = 2;
-        break;
+// Budgets are in 16 us clock counts
+const Task tasks[] PROGMEM =
+{
+  { & drain_midi,      Midi_budget },
+  { & run_modulation,  16          },
+  { & flush_sid,       16          },
+  { & update_ui,       8           },
+  { & render_ui,       250         },
+};
 
-      default:
-        break;
-    }
-    _sid.gate (voice, false);
-    _sid.update ();
-  }
+Scheduler _scheduler (tasks, Default_frame_rate);
 
-  static void pitch_bend (uint8_t channel, int32_t value)
-  {
-  }
-  
-  static void clock (uint8_t counter)
-  {
-  }
-};
+// Values are shown right of the label in the last four columns
+const uint8_t Value_width = 4;
 
 void render_item (uint8_t x, uint8_t y, const char * text, const char * val, bool current)
 {
@@ -228,316 +214,700 @@ void render_item (uint8_t x, uint8_t y, const char * text, const char * val, boo
   }
   if (val)
   {
-    memcpy (row + 16, val, strlen (val));
+    size_t length = strlen (val);
+    memcpy (row + 16, val, length < Value_width ? length : Value_width);
   }
   
   _oled.write_text (0, y, row, current);
 }
 
-void read_setting (Setting setting, uint8_t voice, char * val)
+// Menu entries that are not part of the patch. Their ids follow the
+// patch parameters so pages can mix both.
+enum Control
 {
-  itoa (_settings.get (setting, voice), val, 10);
+  PATCH_PROGRAM = Num_settings,
+  PATCH_SAVE,
+  PATCH_LATENCY,
+  MORPH_ENABLE,
+  MORPH_A,
+  MORPH_B,
+  MORPH_POSITION,
+  DIAG_FRAME_RATE,
+  DIAG_LATE_FRAMES,
+  DIAG_OVERRUNS_MIDI,
+  DIAG_OVERRUNS_MODULATION,
+  DIAG_OVERRUNS_SID,
+  DIAG_OVERRUNS_UI,
+  DIAG_OVERRUNS_RENDER,
+  DIAG_RX_DROPPED,
+  DIAG_RX_OVERRUNS,
+  DIAG_RX_PEAK,
+  DIAG_SYSEX_RECEIVED,
+  DIAG_SYSEX_ERRORS,
+  STREAM_INPUT,
+  STREAM_FRAMES,
+  STREAM_LOST,
+  STREAM_ERRORS,
+  STREAM_UNDERRUNS,
+  RAM_STACK_FREE,
+  RAM_STACK_PEAK,
+  RAM_STATIC,
+  RAM_SID,
+  RAM_SETTINGS,
+  RAM_CACHE,
+  RAM_MORPH,
+  RAM_MODULATION,
+  RAM_MENU,
+  RAM_UI,
+  RAM_MIDI,
+  RAM_RX_BUFFER,
+  RAM_STREAM,
+  RAM_SYSEX,
+  RAM_SCHEDULER,
+#ifdef PROFILE
+  PROFILE_VIEW,
+  PROFILE_RESET,
+  PROFILE_NOTE_ON,
+  PROFILE_SID_UPDATE,
+  PROFILE_RENDER,
+  PROFILE_SAVE,
+  PROFILE_TIMER_ISR,
+  PROFILE_PCINT_ISR,
+  PROFILE_UART_ISR,
+  PROFILE_EEPROM_ISR,
+#endif
+};
+
+struct Control_item
+{
+  const char * label;
+  uint8_t      max;
+  uint8_t      arg;
+  void (*read) (uint8_t arg, char * val);
+  void (*write) (uint8_t arg, int8_t val);
+};
+
+// User programs are shown by number, factory presets by name
+void format_program (uint8_t program, char * val)
+{
+  if (program < Num_patches)
+  {
+    itoa (program + 1, val, 10);
+  }
+
+  else
+  {
+    strcpy_P (val, presets[program - Num_patches].name);
+  }
 }
 
-void write_setting (Setting setting, uint8_t voice, int8_t val)
+// Four characters fit, so large counts are shown in thousands
+void format_count (uint32_t count, char * val)
 {
-  _settings.set (setting, voice, _settings.get (setting, voice) + val);
-  int16_t new_val = _settings.get (setting, voice);
+  if (count < 10000)
+  {
+    ultoa (count, val, 10);
+  }
 
-  switch (setting)
+  else
   {
-    case VOICE_FREQUENCY:
-      _sid.set_frequency (voice, new_val * 512);
-      break;
+    ultoa (count / 1000, val, 10);
+    strcat (val, "K");
+  }
+}
 
-    case VOICE_SHAPE:
-      {
-        uint8_t shape = 1;
-
-        switch (new_val)
-        {
-          case 0:
-          shape <<= 0;
-          break;
-
-          case 1:
-          shape <<= 1;
-          break;
-
-          case 2:
-          shape <<= 2;
-          break;
-
-          case 3:
-          shape <<= 3;
-          break;
-
-          default:
-          break;
-        }
-        _sid.set_shape (voice, shape);
-      }
-      break;
-       
-    case VOICE_PW:
-      _sid.set_pulsewidth (voice, new_val * 32);
-      break; 
-    
-    case VOICE_ATTACK:
-      _sid.set_attack (voice, new_val);
-      break;
+void read_program (uint8_t, char * val)
+{
+  format_program (Synth::selected_program (), val);
+}
 
-    case VOICE_DECAY:
-      _sid.set_decay (voice, new_val);
-      break;
+void write_program (uint8_t, int8_t val)
+{
+  int16_t program = Synth::selected_program () + val;
+  program = program < 0 ? 0 : program >= Num_programs ? Num_programs - 1 : program;
 
-    case VOICE_SUSTAIN:
-      _sid.set_sustain (voice, new_val);
-      break;
+  // Stopping at either end must not reload the program and lose its edits
+  if (program != Synth::selected_program ())
+    Synth::select_program (program);
+}
 
-    case VOICE_RELEASE:
-      _sid.set_release (voice, new_val);
-      break;
+void read_save (uint8_t, char * val)
+{
+  if (_settings.saving ())
+    strcpy_P (val, strings::busy);
+}
 
-    case VOICE_GATE:
-      _sid.gate (voice, new_val);
-      break;
- 
-    case VOICE_FILTER:
-      _sid.set_filter (voice, new_val);
-      break;
- 
-    case FILTER_CUTOFF:
-      _sid.set_filter_cutoff (new_val * 8);
+void write_save (uint8_t, int8_t val)
+{
+  _settings.save ();
+}
+
+// Past 9999 us, in thousands: milliseconds
+void read_latency (uint8_t, char * val)
+{
+  format_count (Synth::program_latency, val);
+}
+
+void read_morph_enable (uint8_t, char * val)
+{
+  strcpy_P (val, Synth::morph.enabled () ? strings::on : strings::off);
+}
+
+void write_morph_enable (uint8_t, int8_t val)
+{
+  Synth::morph.set_enabled (val > 0);
+}
+
+void read_morph_source (uint8_t index, char * val)
+{
+  format_program (Synth::morph_programs[index], val);
+}
+
+void write_morph_source (uint8_t index, int8_t val)
+{
+  int16_t program = Synth::morph_programs[index] + val;
+  program = program < 0 ? 0 : program >= Num_programs ? Num_programs - 1 : program;
+
+  if (program != Synth::morph_programs[index])
+    Synth::select_morph_source (index, program);
+}
+
+void read_morph_position (uint8_t, char * val)
+{
+  itoa (Synth::morph.position (), val, 10);
+}
+
+void write_morph_position (uint8_t, int8_t val)
+{
+  int16_t position = Synth::morph.position () + val;
+  Synth::morph.set_position (position < 0 ? 0 : position > 127 ? 127 : position);
+}
+
+void read_overruns (uint8_t slot, char * val)
+{
+  utoa (_scheduler.overruns (slot), val, 10);
+}
+
+void read_late_frames (uint8_t, char * val)
+{
+  utoa (_scheduler.late_frames (), val, 10);
+}
+
+void read_rx_dropped (uint8_t, char * val)
+{
+  format_count (uart_stats.dropped, val);
+}
+
+void read_rx_overruns (uint8_t, char * val)
+{
+  format_count (uart_stats.overruns, val);
+}
+
+void read_rx_peak (uint8_t, char * val)
+{
+  utoa (uart_stats.high_water, val, 10);
+}
+
+void read_sysex_received (uint8_t, char * val)
+{
+  format_count (Synth::sysex.received (), val);
+}
+
+void read_sysex_errors (uint8_t, char * val)
+{
+  format_count (Synth::sysex.errors (), val);
+}
+
+const char * const input_names[] PROGMEM =
+{
+  strings::in_midi,
+  strings::in_slow,
+#if UART_BUFFER_SIZE >= 128
+  strings::in_fast,
+#endif
+};
+
+void read_input (uint8_t, char * val)
+{
+  strcpy_P (val, (const char *) pgm_read_ptr (& input_names[_input]));
+}
+
+void write_input (uint8_t, int8_t val)
+{
+  int8_t mode = _input + val;
+  set_input (mode < 0 ? 0 : mode >= Num_inputs ? Num_inputs - 1 : mode);
+}
+
+enum Stream_counter
+{
+  Stream_frames = 0,
+  Stream_lost,
+  Stream_errors,
+  Stream_underruns,
+};
+
+void read_stream_counter (uint8_t counter, char * val)
+{
+  auto & stats = _stream.stats ();
+
+  switch (counter)
+  {
+    case Stream_frames:
+      format_count (stats.frames, val);
       break;
- 
-    case FILTER_RESONANCE:
-      _sid.set_filter_resonance (new_val);
+
+    case Stream_lost:
+      format_count (stats.lost, val);
       break;
- 
-    case FILTER_MODE:
- {
-        uint8_t mode = 1;
-
-        switch (new_val)
-        {
-          case 0:
-          mode <<= 0;
-          break;
-
-          case 1:
-          mode <<= 1;
-          break;
-
-          case 2:
-          mode <<= 2;
-          break;
-
-          default:
-          break;
-        }
-        _sid.set_filter_mode (mode);
-      }
+
+    case Stream_errors:
+      format_count (stats.errors, val);
       break;
 
     default:
+      format_count (stats.underruns, val);
       break;
-  } 
-  _sid.update ();
-}
-
-MenuItem voice1_items[]
-{  
-  { strings::voice1,  nullptr   , nullptr        },
-  { strings::frequency, [] (char * val) { read_setting  (VOICE_FREQUENCY, 0, val); }, 
-            [] (int8_t v)   { write_setting (VOICE_FREQUENCY, 0, v); } }, 
-  { strings::shape,   [] (char * val) 
-               { 
-                 const char * res = "";
-
-                 switch (_settings.get (VOICE_SHAPE, 0))
-                 {
-                   case 0:
-                     res = strings::tri;
-                     break;
-                   case 1:
-                     res = strings::saw;
-                     break;
-                   case 2:
-                     res =  strings::squ;
-                     break;
-                   case 3:
-                     res = strings::noise;
-                   default:
-                     break;
-                 }; 
-
-                 memcpy_P (val, res, 4);
-               }, 
-               [] (int8_t v) { write_setting (VOICE_SHAPE, 0, v); } },
-  { strings::pulsewidth, [] (char * val) { read_setting  (VOICE_PW, 0, val); }, 
-                 [] (int8_t v)   { write_setting (VOICE_PW, 0, v); } },
-  { strings::attack,  [] (char * val) { read_setting  (VOICE_ATTACK, 0, val); }, 
-               [] (int8_t v)   { write_setting (VOICE_ATTACK, 0, v); } }, 
-
-  { strings::decay,   [] (char * val) { read_setting  (VOICE_DECAY, 0, val); }, 
-               [] (int8_t v)   { write_setting (VOICE_DECAY, 0, v); } }, 
-
-  { strings::sustain, [] (char * val) { read_setting  (VOICE_SUSTAIN, 0, val); }, 
-               [] (int8_t v)   { write_setting (VOICE_SUSTAIN, 0, v); } }, 
-
-  { strings::release, [] (char * val) { read_setting  (VOICE_RELEASE, 0, val); }, 
-               [] (int8_t v)   { write_setting (VOICE_RELEASE, 0, v); } }, 
-
-  { strings::gate,    [] (char * val) { read_setting  (VOICE_GATE, 0, val); }, 
-               [] (int8_t v)   { write_setting (VOICE_GATE, 0, v); } }, 
-  { strings::filter,  [] (char * val) { read_setting  (VOICE_FILTER, 0, val); }, 
-               [] (int8_t v)   { write_setting (VOICE_FILTER, 0, v); } },  
+  }
+}
+
+void read_frame_rate (uint8_t, char * val)
+{
+  utoa (_scheduler.frame_rate (), val, 10);
+}
+
+// One step is one timer tick less or more per frame, so every step
+// changes the rate shown
+const uint8_t Frame_steps = Max_frame_ticks - Min_frame_ticks;
+
+void write_frame_rate (uint8_t, int8_t val)
+{
+  _scheduler.set_frame_ticks (_scheduler.frame_ticks () - val);
+}
+
+void read_stack_free (uint8_t, char * val)
+{
+  utoa (stack_unused (), val, 10);
+}
+
+void read_stack_peak (uint8_t, char * val)
+{
+  utoa (stack_peak (), val, 10);
+}
+
+void read_static_ram (uint8_t, char * val)
+{
+  utoa (static_ram (), val, 10);
+}
+
+// Static RAM cost of the larger objects. Menu pages, parameter tables and
+// strings live in flash and do not show up here.
+enum Ram_object
+{
+  Ram_sid = 0,
+  Ram_settings,
+  Ram_cache,
+  Ram_morph,
+  Ram_modulation,
+  Ram_menu,
+  Ram_ui,
+  Ram_midi,
+  Ram_rx_buffer,
+  Ram_stream,
+  Ram_sysex,
+  Ram_scheduler,
 };
 
-MenuItem voice2_items[]
-{  
-  { strings::voice2,  nullptr   , nullptr        },
-  { strings::frequency, [] (char * val) { read_setting  (VOICE_FREQUENCY, 1, val); }, 
-            [] (int8_t v)   { write_setting (VOICE_FREQUENCY, 1, v); } }, 
-  { strings::shape,   [] (char * val) 
-               { 
-                 const char * res = "";
-
-                 switch (_settings.get (VOICE_SHAPE, 1))
-                 {
-                   case 0:
-                     res = strings::tri;
-                     break;
-                   case 1:
-                     res = strings::saw;
-                     break;
-                   case 2:
-                     res =  strings::squ;
-                     break;
-                   case 3:
-                     res = strings::noise;
-                   default:
-                     break;
-                 }; 
-
-                 memcpy_P (val, res, 4);
-               }, 
-               [] (int8_t v) { write_setting (VOICE_SHAPE, 1, v); } },
-  { strings::pulsewidth, [] (char * val) { read_setting  (VOICE_PW, 1, val); }, 
-                 [] (int8_t v)   { write_setting (VOICE_PW, 1, v); } },
-  { strings::attack,  [] (char * val) { read_setting  (VOICE_ATTACK, 1, val); }, 
-               [] (int8_t v)   { write_setting (VOICE_ATTACK, 1, v); } }, 
-
-  { strings::decay,   [] (char * val) { read_setting  (VOICE_DECAY, 1, val); }, 
-               [] (int8_t v)   { write_setting (VOICE_DECAY, 1, v); } }, 
-
-  { strings::sustain, [] (char * val) { read_setting  (VOICE_SUSTAIN, 1, val); }, 
-               [] (int8_t v)   { write_setting (VOICE_SUSTAIN, 1, v); } }, 
-
-  { strings::release, [] (char * val) { read_setting  (VOICE_RELEASE, 1, val); }, 
-               [] (int8_t v)   { write_setting (VOICE_RELEASE, 1, v); } }, 
-
-  { strings::gate,  [] (char * val) { read_setting  (VOICE_GATE, 1, val); }, 
-               [] (int8_t v)   { write_setting (VOICE_GATE, 1, v); } }, 
-  { strings::filter,  [] (char * val) { read_setting  (VOICE_FILTER, 1, val); }, 
-               [] (int8_t v)   { write_setting (VOICE_FILTER, 1, v); } },
-               
+const uint16_t ram_sizes[] PROGMEM =
+{
+  sizeof (Sid<SidHandler>),
+  sizeof (Settings),
+  sizeof (Patch_cache),
+  sizeof (Morph),
+  sizeof (Modulation),
+  sizeof (Menu),
+  sizeof (Ui<Oled<Oled_spi>>),
+  sizeof (Midi<Synth>),
+  sizeof (_buffer),
+  sizeof (Register_stream<>),
+  sizeof (Sysex<Synth>),
+  sizeof (Scheduler),
 };
 
-MenuItem voice3_items[]
-{  
-  { strings::voice3,  nullptr   , nullptr        },
-  { strings::frequency, [] (char * val) { read_setting  (VOICE_FREQUENCY, 2, val); }, 
-            [] (int8_t v)   { write_setting (VOICE_FREQUENCY, 2, v); } }, 
-  { strings::shape,  [] (char * val) 
-               { 
-                 const char * res = "";
-
-                 switch (_settings.get (VOICE_SHAPE, 2))
-                 {
-                   case 0:
-                     res = strings::tri;
-                     break;
-                   case 1:
-                     res = strings::saw;
-                     break;
-                   case 2:
-                     res =  strings::squ;
-                     break;
-                   case 3:
-                     res = strings::noise;
-                   default:
-                     break;
-                 }; 
-
-                 memcpy_P (val, res, 4);
-               }, 
-               [] (int8_t v) { write_setting (VOICE_SHAPE, 2, v); } },
-  { strings::pulsewidth, [] (char * val) { read_setting  (VOICE_PW, 2, val); }, 
-                 [] (int8_t v)   { write_setting (VOICE_PW, 2, v); } },
-  { strings::attack,  [] (char * val) { read_setting  (VOICE_ATTACK, 2, val); }, 
-               [] (int8_t v)   { write_setting (VOICE_ATTACK, 2, v); } }, 
-
-  { strings::decay,  [] (char * val) { read_setting  (VOICE_DECAY, 2, val); }, 
-               [] (int8_t v)   { write_setting (VOICE_DECAY, 2, v); } }, 
-
-  { strings::sustain, [] (char * val) { read_setting  (VOICE_SUSTAIN, 2, val); }, 
-               [] (int8_t v)   { write_setting (VOICE_SUSTAIN, 2, v); } }, 
-
-  { strings::release, [] (char * val) { read_setting  (VOICE_RELEASE, 2, val); }, 
-               [] (int8_t v)   { write_setting (VOICE_RELEASE, 2, v); } }, 
-
-  { strings::gate,  [] (char * val) { read_setting  (VOICE_GATE, 2, val); }, 
-               [] (int8_t v)   { write_setting (VOICE_GATE, 2, v); } }, 
-  { strings::filter,  [] (char * val) { read_setting  (VOICE_FILTER, 2, val); }, 
-               [] (int8_t v)   { write_setting (VOICE_FILTER, 2, v); } },
-}; 
-
-MenuItem filter_items[]
-{
-  { strings::filter, nullptr, nullptr     },
-  { strings::type,   [] (char * val)    
-              { 
-                 const char * res = "";
-
-                 switch (_settings.get (FILTER_MODE, 0))
-                 {
-                   case 0:
-                     res = strings::lp;
-                     break;
-                   case 1:
-                     res = strings::bp;
-                     break;
-                   case 2:
-                     res = strings::hp;
-                   default:
-                     break;
-                 }; 
-
-                 memcpy_P (val, res, 4);
-               }, 
-              [] (int8_t v)   { write_setting (FILTER_MODE, 0, v); } },
-  { strings::cutoff, [] (char * val) { read_setting  (FILTER_CUTOFF, 0, val); }, 
-              [] (int8_t v)   { write_setting (FILTER_CUTOFF, 0, v); } },
-  { strings::resonance,    [] (char * val) { read_setting  (FILTER_RESONANCE, 0, val); }, 
-              [] (int8_t v)   { write_setting (FILTER_RESONANCE, 0, v); } },
+void read_ram_size (uint8_t object, char * val)
+{
+  utoa (pgm_read_word (& ram_sizes[object]), val, 10);
+}
+
+#ifdef PROFILE
+const char * const profile_view_names[] PROGMEM =
+{
+  strings::min,
+  strings::avg,
+  strings::max,
 };
 
-Menu menu (& voice1_items[0], & render_item, strings::mark);
+uint8_t _profile_view = 1;
 
-Encoder _e1 (DDRC, PORTC, PINC, enc1_a, enc1_b, sw1);
-Encoder _e2 (DDRC, PORTC, PINC, enc2_a, enc2_b, sw2);
-Ui _ui (_e1, _e2, menu, _oled, _settings);
-Uart _serial;
-Midi<MidiHandler> _midi (_serial); 
+void read_profile_view (uint8_t, char * val)
+{
+  strcpy_P (val, (const char *) pgm_read_ptr (& profile_view_names[_profile_view]));
+}
+
+void write_profile_view (uint8_t, int8_t val)
+{
+  int8_t view = _profile_view + val;
+  _profile_view = view < 0 ? 0 : view > 2 ? 2 : view;
+}
+
+void write_profile_reset (uint8_t, int8_t)
+{
+  _profiler.reset ();
+}
+
+void read_profile (uint8_t probe, char * val)
+{
+  uint32_t cycles = _profile_view == 0 ? Profiler::min (probe)
+                  : _profile_view == 1 ? Profiler::avg (probe)
+                  :                      Profiler::max (probe);
+
+  format_count (cycles, val);
+}
+#endif
+
+const Control_item controls[] PROGMEM =
+{
+  { strings::program,    Num_programs - 1, 0,                & read_program,        & write_program       },
+  { strings::save,       0,                0,                & read_save,           & write_save          },
+  { strings::latency,    0,                0,                & read_latency,        nullptr               },
+  { strings::enable,     1,                0,                & read_morph_enable,   & write_morph_enable  },
+  { strings::patch_a,    Num_programs - 1, 0,                & read_morph_source,   & write_morph_source  },
+  { strings::patch_b,    Num_programs - 1, 1,                & read_morph_source,   & write_morph_source  },
+  { strings::position,   127,              0,                & read_morph_position, & write_morph_position },
+  { strings::frame_hz,   Frame_steps,      0,                & read_frame_rate,     & write_frame_rate    },
+  { strings::late,       0,                0,                & read_late_frames,    nullptr               },
+  { strings::ovr_midi,   0,                Task_midi,        & read_overruns,       nullptr               },
+  { strings::ovr_mod,    0,                Task_modulation,  & read_overruns,       nullptr               },
+  { strings::ovr_sid,    0,                Task_sid,         & read_overruns,       nullptr               },
+  { strings::ovr_ui,     0,                Task_ui,          & read_overruns,       nullptr               },
+  { strings::ovr_draw,   0,                Task_render,      & read_overruns,       nullptr               },
+  { strings::rx_drop,    0,                0,                & read_rx_dropped,     nullptr               },
+  { strings::rx_overrun, 0,                0,                & read_rx_overruns,    nullptr               },
+  { strings::rx_peak,    0,                0,                & read_rx_peak,        nullptr               },
+  { strings::sysex_in,   0,                0,                & read_sysex_received, nullptr               },
+  { strings::sysex_err,  0,                0,                & read_sysex_errors,   nullptr               },
+  { strings::input,      Num_inputs - 1,   0,                & read_input,          & write_input         },
+  { strings::frames,     0,                Stream_frames,    & read_stream_counter, nullptr               },
+  { strings::lost,       0,                Stream_lost,      & read_stream_counter, nullptr               },
+  { strings::errors,     0,                Stream_errors,    & read_stream_counter, nullptr               },
+  { strings::underruns,  0,                Stream_underruns, & read_stream_counter, nullptr               },
+  { strings::stack_free, 0,                0,                & read_stack_free,     nullptr               },
+  { strings::stack_peak, 0,                0,                & read_stack_peak,     nullptr               },
+  { strings::ram_static, 0,                0,                & read_static_ram,     nullptr               },
+  { strings::ram_sid,    0,                Ram_sid,          & read_ram_size,       nullptr               },
+  { strings::ram_set,    0,                Ram_settings,     & read_ram_size,       nullptr               },
+  { strings::ram_cache,  0,                Ram_cache,        & read_ram_size,       nullptr               },
+  { strings::ram_morph,  0,                Ram_morph,        & read_ram_size,       nullptr               },
+  { strings::ram_mod,    0,                Ram_modulation,   & read_ram_size,       nullptr               },
+  { strings::ram_menu,   0,                Ram_menu,         & read_ram_size,       nullptr               },
+  { strings::ram_ui,     0,                Ram_ui,           & read_ram_size,       nullptr               },
+  { strings::ram_midi,   0,                Ram_midi,         & read_ram_size,       nullptr               },
+  { strings::ram_rx,     0,                Ram_rx_buffer,    & read_ram_size,       nullptr               },
+  { strings::ram_stream, 0,                Ram_stream,       & read_ram_size,       nullptr               },
+  { strings::ram_sysex,  0,                Ram_sysex,        & read_ram_size,       nullptr               },
+  { strings::ram_sched,  0,                Ram_scheduler,    & read_ram_size,       nullptr               },
+#ifdef PROFILE
+  { strings::view,       2,                0,                & read_profile_view,   & write_profile_view  },
+  { strings::reset,      0,                0,                nullptr,               & write_profile_reset },
+  { strings::prof_note,  0,                Probe_note_on,    & read_profile,        nullptr               },
+  { strings::prof_sid,   0,                Probe_sid_update, & read_profile,        nullptr               },
+  { strings::prof_draw,  0,                Probe_render,     & read_profile,        nullptr               },
+  { strings::prof_save,  0,                Probe_save,       & read_profile,        nullptr               },
+  { strings::prof_t0,    0,                Probe_timer_isr,  & read_profile,        nullptr               },
+  { strings::prof_pc,    0,                Probe_pcint_isr,  & read_profile,        nullptr               },
+  { strings::prof_rx,    0,                Probe_uart_isr,   & read_profile,        nullptr               },
+  { strings::prof_ee,    0,                Probe_eeprom_isr, & read_profile,        nullptr               },
+#endif
+};
+
+Control_item get_control (uint8_t id)
+{
+  Control_item c;
+  memcpy_P (& c, & controls[id - Num_settings], sizeof (c));
+  return c;
+}
+
+const char * read_setting (uint8_t setting, uint8_t voice, char * val)
+{
+  if (setting >= Num_settings)
+  {
+    auto c = get_control (setting);
+
+    if (c.read)
+      c.read (c.arg, val);
+
+    return c.label;
+  }
+
+  auto p = get_parameter (setting);
+  auto v = _settings.get (static_cast<Setting> (setting), voice);
+
+  if (_settings.controls ().learning () == cc_target (setting, voice))
+  {
+    strcpy_P (val, strings::learn);
+  }
+
+  else if (p.names)
+  {
+    strcpy_P (val, (const char *) pgm_read_ptr (& p.names[v]));
+  }
+
+  else
+  {
+    itoa (v, val, 10);
+  }
+
+  return p.label;
+}
+
+void write_setting (uint8_t setting, uint8_t voice, int8_t val)
+{
+  if (setting >= Num_settings)
+  {
+    auto c = get_control (setting);
+
+    if (c.write)
+      c.write (c.arg, val);
+
+    return;
+  }
+
+  auto s = static_cast<Setting> (setting);
+  auto p = get_parameter (setting);
+
+  int16_t v = _settings.get (s, voice) + val;
+  Synth::set_parameter (s, voice, v < 0 ? 0 : v > p.max ? p.max : v);
+}
+
+uint8_t range_setting (uint8_t setting)
+{
+  if (setting >= Num_settings)
+    return get_control (setting).max;
+
+  return get_parameter (setting).max;
+}
+
+const uint8_t voice_items[] PROGMEM =
+{
+  VOICE_FREQUENCY,
+  VOICE_SHAPE,
+  VOICE_PW,
+  VOICE_ATTACK,
+  VOICE_DECAY,
+  VOICE_SUSTAIN,
+  VOICE_RELEASE,
+  VOICE_GATE,
+  VOICE_FILTER,
+  VOICE_VELOCITY_DEST,
+  VOICE_VELOCITY_DEPTH,
+  VOICE_PRESSURE_DEST,
+  VOICE_PRESSURE_DEPTH,
+};
+
+const uint8_t filter_items[] PROGMEM =
+{
+  FILTER_MODE,
+  FILTER_CUTOFF,
+  FILTER_RESONANCE,
+};
+
+const uint8_t patch_items[] PROGMEM =
+{
+  PATCH_PROGRAM,
+  PATCH_SAVE,
+  PATCH_LATENCY,
+};
+
+const uint8_t morph_items[] PROGMEM =
+{
+  MORPH_ENABLE,
+  MORPH_A,
+  MORPH_B,
+  MORPH_POSITION,
+};
+
+const uint8_t diag_items[] PROGMEM =
+{
+  DIAG_FRAME_RATE,
+  DIAG_LATE_FRAMES,
+  DIAG_OVERRUNS_MIDI,
+  DIAG_OVERRUNS_MODULATION,
+  DIAG_OVERRUNS_SID,
+  DIAG_OVERRUNS_UI,
+  DIAG_OVERRUNS_RENDER,
+  DIAG_RX_DROPPED,
+  DIAG_RX_OVERRUNS,
+  DIAG_RX_PEAK,
+  DIAG_SYSEX_RECEIVED,
+  DIAG_SYSEX_ERRORS,
+};
+
+const uint8_t stream_items[] PROGMEM =
+{
+  STREAM_INPUT,
+  STREAM_FRAMES,
+  STREAM_LOST,
+  STREAM_ERRORS,
+  STREAM_UNDERRUNS,
+};
+
+const uint8_t ram_items[] PROGMEM =
+{
+  RAM_STACK_FREE,
+  RAM_STACK_PEAK,
+  RAM_STATIC,
+  RAM_SID,
+  RAM_SETTINGS,
+  RAM_CACHE,
+  RAM_MORPH,
+  RAM_MODULATION,
+  RAM_MENU,
+  RAM_UI,
+  RAM_MIDI,
+  RAM_RX_BUFFER,
+  RAM_STREAM,
+  RAM_SYSEX,
+  RAM_SCHEDULER,
+};
+
+#ifdef PROFILE
+const uint8_t profile_items[] PROGMEM =
+{
+  PROFILE_VIEW,
+  PROFILE_RESET,
+  PROFILE_NOTE_ON,
+  PROFILE_SID_UPDATE,
+  PROFILE_RENDER,
+  PROFILE_SAVE,
+  PROFILE_TIMER_ISR,
+  PROFILE_PCINT_ISR,
+  PROFILE_UART_ISR,
+  PROFILE_EEPROM_ISR,
+};
+#endif
+
+const MenuPage menu_pages[] PROGMEM =
+{
+  make_page (strings::voice1, voice_items, _1),
+  make_page (strings::voice2, voice_items, _2),
+  make_page (strings::voice3, voice_items, _3),
+  make_page (strings::filter, filter_items),
+  make_page (strings::patch,  patch_items),
+  make_page (strings::morph,  morph_items),
+  make_page (strings::diag,   diag_items),
+  make_page (strings::stream, stream_items),
+  make_page (strings::ram,    ram_items),
+#ifdef PROFILE
+  make_page (strings::prof,   profile_items),
+#endif
+};
+
+Menu menu (menu_pages, & render_item, & read_setting, & write_setting, & range_setting, strings::mark);
+
+Encoder _e1 (DDRC, PORTC, PINC, PCMSK1, enc1_a, enc1_b, sw1);
+Encoder _e2 (DDRC, PORTC, PINC, PCMSK1, enc2_a, enc2_b, sw2);
+Ui<Oled<Oled_spi>> _ui (_e1, _e2, menu, _oled, _settings);
+Midi<Synth> _midi (_serial);
+
+// Leaving a stream hands the chip back to the patch
+void set_input (uint8_t mode)
+{
+  if (mode == _input)
+    return;
+
+#if UART_BUFFER_SIZE >= 128
+  _serial.set_baud (mode == Input_stream_fast ? 250000 : 31250);
+#endif
+  _midi.reset ();
+  _stream.reset ();
+  _stream.reset_stats ();
+
+  if (mode == Input_midi)
+  {
+    apply_patch (_sid, _settings.patch ());
+    _sid.set_volume (Master_volume);
+  }
+
+  _input = mode;
+}
+
+// Drains received MIDI or stream frames, giving up after the task budget
+// so a flood of input cannot starve the frame tasks. A stream frame is
+// flushed as soon as it is complete.
+void drain_midi ()
+{
+  uint16_t start = _clock.now ();
+
+  while (_serial.available () && (uint16_t) (_clock.now () - start) < Midi_budget)
+  {
+    if (_input == Input_midi)
+    {
+      _midi.process_next ();
+    }
+
+    else if (_stream.process_next (_clock.now ()))
+    {
+      _stream.apply (_sid);
+      _sid.update ();
+    }
+  }
+}
+
+// While streaming the host owns every register
+void run_modulation ()
+{
+  if (_input == Input_midi)
+    Synth::tick ();
+
+  else
+    _stream.poll (_clock.now ());
+
+  Synth::background ();
+}
+
+void flush_sid ()
+{
+  Synth::flush ();
+}
+
+void update_ui ()
+{
+  _ui.update ();
+  Synth::poll ();
+
+  if (Synth::take_changed ())
+    _ui.invalidate ();
+}
+
+void render_ui ()
+{
+  _ui.render ();
+}
                                                 
 
 ISR(TIMER0_COMPA_vect) 
 {
+  PROFILE_SCOPE (Probe_timer_isr);
+  _clock.tick ();
+  _scheduler.tick ();
   _ui.read_inputs ();
 }
 
+ISR(PCINT1_vect)
+{
+  PROFILE_SCOPE (Probe_pcint_isr);
+  _ui.decode_inputs ();
+}
+
 int main ()
 {
   DDRD = 0;
@@ -574,53 +944,22 @@ int main ()
 
   bit::set (PORTD, sid_cs);
   
-  _settings.load ();
+  Synth::init ();
   _oled.init ();
   _oled.on ();
-  _sid.init ();
-
-  for (uint8_t voice = 0; voice < 3; ++voice)
-  { 
-    write_setting (VOICE_FREQUENCY, voice, 0);
-    write_setting (VOICE_SHAPE, voice,     0);
-    write_setting (VOICE_PW, voice,        0);
-    write_setting (VOICE_ATTACK, voice,    0);
-    write_setting (VOICE_DECAY, voice,     0);
-    write_setting (VOICE_SUSTAIN, voice,   0);
-    write_setting (VOICE_RELEASE, voice,   0);
-    write_setting (VOICE_FILTER, voice,    0); 
-    write_setting (VOICE_GATE, voice,      0);
-  } 
-
-  write_setting (FILTER_MODE, 0,      0);
-  write_setting (FILTER_CUTOFF, 0,    0);
-  write_setting (FILTER_RESONANCE, 0, 0);
-
-  _sid.set_volume (0x0f);
-  _sid.update ();
 
   _e1.init ();
   _e2.init ();
+  PCICR |= _BV (PCIE1);
 
   _ui.init ();
 
-  Menu::link_items (voice1_items);
-  Menu::link_items (voice2_items);
-  Menu::link_items (voice3_items);
-  Menu::link_items (filter_items);
-
-  MenuItem * pages[]
-  {
-    voice1_items,
-    voice2_items,
-    voice3_items,
-    filter_items,
-  };
-
-  menu.init (pages);
-  
   _oled.clear ();
-  menu.render ();
+  _ui.render ();
+
+#ifdef PROFILE
+  _profiler.init ();
+#endif
 
   OCR0A = 63;	
   TCCR0A |= (1 << WGM01);
@@ -631,8 +970,7 @@ int main ()
 
   while (true)
   {
-    _midi.process_next ();
-    _ui.update ();
+    _scheduler.run ();
   }
   
   return 0;
@@ -166,7 +166,10 @@ class Sid
       for (uint8_t reg = Voice_1_freq_lo; reg < Last_register; ++reg)
       {
         if (_registers[reg].current != _registers[reg].previous)
+        {
           Device::write (reg, _registers[reg].current);
+          _registers[reg].copy ();
+        }
       }
     }
 
@@ -194,8 +197,6 @@ class Sid
 
       auto hi = lo + 1;
       
-      _registers[lo].copy ();
-      _registers[hi].copy ();
       _registers[lo].current = frequency;
       _registers[hi].current = frequency >> 8; 
     }
@@ -224,8 +225,6 @@ class Sid
 
       auto hi = lo + 1;
       
-      _registers[lo].copy ();
-      _registers[hi].copy ();
       _registers[lo].current = pulsewidth;
       _registers[hi].current = (pulsewidth >> 8) & 0x0f;
     }
@@ -234,7 +233,6 @@ class Sid
     {
       auto regno = Control_registers[voice];
       auto & reg = _registers[regno];
-      reg.copy ();
 
       if (enabled)
       {
@@ -259,33 +257,29 @@ class Sid
     {
       auto regno = Control_registers[voice];
       auto & reg = _registers[regno];
-      reg.copy ();
 
-      reg.current = (shape_bits << 4) | (reg.previous & 0xf);
+      reg.current = (shape_bits << 4) | (reg.current & 0xf);
     }
 
     void set_attack (uint8_t voice, uint8_t attack)
     {
       auto regno = get_ad_reg (voice);
       auto & reg = _registers[regno];
-      reg.copy ();
-      reg.current = (reg.previous & 0x0f) | (attack << 4); 
+      reg.current = (reg.current & 0x0f) | (attack << 4); 
     }
 
     void set_decay (uint8_t voice, uint8_t decay)
     {
       auto regno = get_ad_reg (voice);
       auto & reg = _registers[regno];
-      reg.copy ();
-      reg.current = (reg.previous & 0xf0) | (decay & 0x0f); 
+      reg.current = (reg.current & 0xf0) | (decay & 0x0f); 
     }
  
     void set_sustain (uint8_t voice, uint8_t sustain)
     {
       auto regno = get_sr_reg (voice);
       auto & reg = _registers[regno];
-      reg.copy ();
-      reg.current = (reg.previous & 0x0f) | (sustain << 4); 
+      reg.current = (reg.current & 0x0f) | (sustain << 4); 
        
     }
  
@@ -293,16 +287,13 @@ class Sid
     {
       auto regno = get_sr_reg (voice);
       auto & reg = _registers[regno];
-      reg.copy ();
-      reg.current = (reg.previous & 0xf0) | (release & 0x0f); 
+      reg.current = (reg.current & 0xf0) | (release & 0x0f); 
     }
 
     void set_filter_cutoff (uint16_t cutoff)
     {
       auto & reg_lo = _registers[Filter_cutoff_lo];
       auto & reg_hi = _registers[Filter_cutoff_hi];
-      reg_lo.copy ();
-      reg_hi.copy ();
       reg_lo.current = cutoff & 0x07;
       reg_hi.current = cutoff >> 3;
     }
@@ -310,14 +301,12 @@ class Sid
     void set_filter_resonance (uint8_t res)
     {
       auto & reg = _registers[Filter_res_en];
-      reg.copy ();
-      reg.current = (reg.previous & 0x0f) | (res << 4);
+      reg.current = (reg.current & 0x0f) | (res << 4);
     }
 
     void set_filter (uint8_t voice, bool enabled)
     {
       auto & reg = _registers[Filter_res_en];
-      reg.copy ();
       if (enabled)
       {
         reg.current |= Filter_enable_bits[voice];
@@ -332,15 +321,44 @@ class Sid
     void set_filter_mode (uint8_t mode)
     {
       auto & reg = _registers[Filter_mode_vol];
-      reg.copy ();
-      reg.current = (reg.previous & 0x0f) | (mode << 4);
+      reg.current = (reg.current & 0x0f) | (mode << 4);
     }
     
+    // Replaces the whole register file; update () then writes the registers
+    // that differ from what the chip holds.
+    // Voices with a bit set in notes keep the frequency and the gate their
+    // note gave them
+    void load_image (const uint8_t * image, uint8_t notes)
+    {
+      for (uint8_t reg = Voice_1_freq_lo; reg < Last_register; ++reg)
+      {
+        uint8_t voice = reg / 7;
+        uint8_t field = reg % 7;
+        uint8_t keep = 0;
+
+        if (voice < 3 && (notes & (1 << voice)))
+          keep = field <= Voice_1_freq_hi ? 0xff : field == Voice_1_control ? Gate_bit : 0;
+
+        auto & r = _registers[reg];
+        r.current = (image[reg] & ~ keep) | (r.current & keep);
+      }
+    }
+
+    void set_bits (uint8_t regno, uint8_t mask, uint8_t bits)
+    {
+      auto & reg = _registers[regno];
+      reg.current = (reg.current & ~ mask) | (bits & mask);
+    }
+
+    void set_register (uint8_t regno, uint8_t value)
+    {
+      _registers[regno].current = value;
+    }
+
     void set_volume (uint8_t volume)
     {
       auto & reg = _registers[Filter_mode_vol];
-      reg.copy ();
-      reg.current = (reg.previous & 0xf0) | volume;
+      reg.current = (reg.current & 0xf0) | volume;
     }
 
   private:
@@ -0,0 +1,65 @@
+#ifndef _SID_BUS_H
+#define _SID_BUS_H
+
+#include <avr/io.h>
+#include <util/delay.h>
+#include "avr_types.h"
+
+// The SID's data and address lines sit behind two chained 74HC595s. A
+// write shifts the data byte and then the address out MSB first, latches
+// both and strobes CS low for at least one cycle of the 1 MHz SID clock.
+
+const uint8_t hc595_data  = PD1;
+const uint8_t hc595_clk   = PD2;
+const uint8_t hc595_latch = PD3;
+const uint8_t sid_cs      = PD6;
+
+struct SidHandler
+{
+  static void write (uint8_t address, uint8_t data)
+  {
+    bit::clear (PORTD, hc595_clk);
+    bit::clear (PORTD, hc595_latch);
+
+    bit::set (PORTD, sid_cs);
+
+    for (int i = 7; i >= 0; --i)
+    {
+      if (data & _BV (i))
+      {
+        bit::set (PORTD, hc595_data);
+      }
+
+      else
+      {
+        bit::clear (PORTD, hc595_data);
+      }
+
+      bit::set (PORTD, hc595_clk);
+      bit::clear (PORTD, hc595_clk);
+    }
+
+    for (int i = 7; i >= 0; --i)
+    {
+      if (address & _BV (i))
+      {
+        bit::set (PORTD, hc595_data);
+      }
+
+      else
+      {
+        bit::clear (PORTD, hc595_data);
+      }
+
+      bit::set (PORTD, hc595_clk);
+      bit::clear (PORTD, hc595_clk);
+    }
+
+    bit::set (PORTD, hc595_latch);
+    bit::clear (PORTD, sid_cs);
+    _delay_us (4);
+    bit::set (PORTD, sid_cs);
+  }
+};
+
+#endif /* _SID_BUS_H */
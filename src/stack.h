@@ -0,0 +1,63 @@
+#ifndef _STACK_H
+#define _STACK_H
+
+#include <stdint.h>
+
+// Linker symbols: end of .bss, start of .data and the initial stack pointer
+extern uint8_t _end;
+extern uint8_t __data_start;
+extern uint8_t __stack;
+
+static constexpr uint8_t Stack_canary = 0xc5;
+
+// Fills the RAM between the end of the static data and the top of the
+// stack with a known pattern before main runs. It sits in .init1, before
+// the C runtime has set up registers, so it is written in assembly.
+void paint_stack () __attribute__ ((naked, used, section (".init1")));
+
+void paint_stack ()
+{
+  asm volatile (
+    "    ldi r30, lo8(_end)\n"
+    "    ldi r31, hi8(_end)\n"
+    "    ldi r24, %0\n"
+    "    ldi r25, hi8(__stack)\n"
+    "    rjmp 2f\n"
+    "1:\n"
+    "    st Z+, r24\n"
+    "2:\n"
+    "    cpi r30, lo8(__stack)\n"
+    "    cpc r31, r25\n"
+    "    brlo 1b\n"
+    "    breq 1b\n"
+    :
+    : "i" (Stack_canary)
+  );
+}
+
+// Bytes above the static data that the stack has never reached
+inline uint16_t stack_unused ()
+{
+  const uint8_t * p = & _end;
+
+  while (p <= & __stack && *p == Stack_canary)
+  {
+    p++;
+  }
+
+  return p - & _end;
+}
+
+// Deepest the stack has been since reset
+inline uint16_t stack_peak ()
+{
+  return & __stack - & _end + 1 - stack_unused ();
+}
+
+// .data and .bss together
+inline uint16_t static_ram ()
+{
+  return & _end - & __data_start;
+}
+
+#endif /* _STACK_H */
@@ -0,0 +1,211 @@
+#ifndef _STREAM_H
+#define _STREAM_H
+
+#include <stdint.h>
+#include "uart.h"
+#include "sid.h"
+
+// Register streaming: a player or tracker on the host drives the chip
+// directly, sending one frame of register writes per playback tick.
+//
+//   0xa5  seq  count  (register value) * count  check
+//
+// seq counts frames modulo 256, so frames lost on the way show up as a
+// gap. check makes the sum of seq, count and all pairs 0 modulo 256. A
+// frame writes up to Last_register pairs and the last write to a
+// register wins. Nothing reaches the register image before the check
+// byte is in, so the chip never plays half a frame.
+static constexpr uint8_t  Stream_sync = 0xa5;
+
+// Frames more than half a second apart mean playback stopped, and the
+// next frame starts a new stream rather than counting as an underrun.
+// The 16 bit clock wraps after about a second, so poll () has to see the
+// pause while it lasts.
+static constexpr uint16_t Stream_restart = 31250;  // 16 us counts
+
+struct Stream_stats
+{
+  uint16_t frames;
+  uint16_t lost;       // frames missing from the sequence
+  uint16_t errors;     // bad count, register or check byte
+  uint16_t underruns;  // frames more than 1.5 periods late
+};
+
+template<class TSerial = Uart>
+class Register_stream
+{
+  enum State
+  {
+    Sync,
+    Sequence,
+    Count,
+    Address,
+    Value,
+    Check,
+  };
+
+  public:
+
+    Register_stream (TSerial & serial)
+      : _serial (serial)
+      , _stats {}
+    {
+      reset ();
+    }
+
+    // Waits for the next frame, forgetting any partial one and the timing
+    void reset ()
+    {
+      _state = Sync;
+      _dirty = 0;
+      _started = false;
+      _period = 0;
+    }
+
+    void reset_stats ()
+    {
+      _stats = {};
+    }
+
+    const Stream_stats & stats () const
+    {
+      return _stats;
+    }
+
+    // Called every frame while streaming: ends the stream after a pause,
+    // before the clock can wrap and make it look short
+    void poll (uint16_t now)
+    {
+      if (_started && (uint16_t) (now - _last) >= Stream_restart)
+        _started = false;
+    }
+
+    // Reads one byte, now is the clock in 16 us counts. Returns true
+    // when it completed a valid frame, which apply () then hands over.
+    bool process_next (uint16_t now)
+    {
+      if (!_serial.available ())
+      {
+        return false;
+      }
+
+      uint8_t data = _serial.receive ();
+
+      switch (_state)
+      {
+        case Sync:
+          if (data == Stream_sync)
+            _state = Sequence;
+          break;
+
+        case Sequence:
+          _sequence = data;
+          _sum = data;
+          _state = Count;
+          break;
+
+        case Count:
+          if (data > Last_register)
+            return error (data);
+
+          _count = data;
+          _sum += data;
+          _dirty = 0;
+          _state = _count ? Address : Check;
+          break;
+
+        case Address:
+          if (data >= Last_register)
+            return error (data);
+
+          _address = data;
+          _sum += data;
+          _state = Value;
+          break;
+
+        case Value:
+          _image[_address] = data;
+          _dirty |= (uint32_t) 1 << _address;
+          _sum += data;
+          _state = --_count ? Address : Check;
+          break;
+
+        case Check:
+          if ((uint8_t) (_sum + data))
+            return error (data);
+
+          _state = Sync;
+          received (now);
+          return true;
+      }
+
+      return false;
+    }
+
+    // Copies the registers of the last frame into the image. The next
+    // update () writes them out in address order.
+    template<class TSid>
+    void apply (TSid & sid)
+    {
+      for (uint8_t reg = Voice_1_freq_lo; reg < Last_register; ++reg)
+      {
+        if (_dirty & ((uint32_t) 1 << reg))
+          sid.set_register (reg, _image[reg]);
+      }
+
+      _dirty = 0;
+    }
+
+  private:
+
+    // A sync byte where the frame was broken starts the next one
+    bool error (uint8_t data)
+    {
+      _stats.errors++;
+      _state = data == Stream_sync ? Sequence : Sync;
+      return false;
+    }
+
+    void received (uint16_t now)
+    {
+      uint16_t interval = now - _last;
+
+      _stats.frames++;
+
+      if (_started && interval < Stream_restart)
+      {
+        _stats.lost += (uint8_t) (_sequence - _last_sequence - 1);
+
+        if (_period && interval > _period + _period / 2)
+          _stats.underruns++;
+
+        // Follows tempo changes within a few frames
+        _period = _period ? ((uint32_t) _period * 3 + interval) / 4 : interval;
+      }
+
+      else
+      {
+        _period = 0;
+      }
+
+      _started = true;
+      _last = now;
+      _last_sequence = _sequence;
+    }
+
+    TSerial &    _serial;
+    Stream_stats _stats;
+    State        _state;
+    uint8_t      _sequence;
+    uint8_t      _last_sequence;
+    uint8_t      _count;
+    uint8_t      _address;
+    uint8_t      _sum;
+    uint8_t      _image[Last_register];
+    uint32_t     _dirty;
+    bool         _started;
+    uint16_t     _last;
+    uint16_t     _period;
+};
+
+#endif /* _STREAM_H */
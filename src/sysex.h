@@ -0,0 +1,216 @@
+#ifndef _SYSEX_H
+#define _SYSEX_H
+
+#include <stdint.h>
+#include "patch.h"
+
+// System exclusive messages, all under the non-commercial manufacturer id:
+//
+//   f0 7d 53 01 program data[27] check f7    patch
+//   f0 7d 53 02 setting voice value f7        parameter change
+//
+// Patch data is the packed patch in 7 bit groups: each group of up to
+// seven bytes is sent as one byte holding their top bits (bit 0 for the
+// first byte) followed by the low seven bits of each. check makes the
+// 7 bit sum of program, data and check 0.
+//
+// Programs below Num_patches are stored in the bank, Sysex_edit_buffer
+// replaces the current sound without storing it. A bank is sixteen patch
+// messages. Storing one takes Record_write_ms (bank.h, 153 ms) of EEPROM
+// writes and only one more patch can wait in RAM, so messages must be at
+// least that far apart or patches are turned away.
+static constexpr uint8_t Sysex_manufacturer = 0x7d;
+static constexpr uint8_t Sysex_device       = 0x53;
+static constexpr uint8_t Sysex_patch        = 0x01;
+static constexpr uint8_t Sysex_parameter    = 0x02;
+static constexpr uint8_t Sysex_edit_buffer  = 0x7f;
+
+static constexpr uint8_t Sysex_header_size  = 3;
+static constexpr uint8_t Sysex_packed_size  = Patch_size + (Patch_size + 6) / 7;
+
+// Packs length bytes into 7 bit groups, returns the packed length
+inline uint8_t sysex_pack (const uint8_t * src, uint8_t length, uint8_t * dst)
+{
+  uint8_t n = 0;
+
+  for (uint8_t i = 0; i < length; i += 7)
+  {
+    uint8_t & msbs = dst[n++] = 0;
+
+    for (uint8_t j = 0; j < 7 && i + j < length; ++j)
+    {
+      msbs |= (src[i + j] >> 7) << j;
+      dst[n++] = src[i + j] & 0x7f;
+    }
+  }
+
+  return n;
+}
+
+inline uint8_t sysex_checksum (const uint8_t * data, uint8_t length)
+{
+  uint8_t sum = 0;
+
+  for (uint8_t i = 0; i < length; ++i)
+  {
+    sum += data[i];
+  }
+
+  return -sum & 0x7f;
+}
+
+// Decodes messages a byte at a time as the MIDI parser hands them over,
+// unpacking patch data straight into one Patch. Finished messages go to
+// the callback:
+//
+//   bool patch (uint8_t program, const Patch & patch)
+//   bool parameter (uint8_t setting, uint8_t voice, uint8_t value)
+//
+// which return false if they could not take the message.
+template<class TCallback>
+class Sysex
+{
+  public:
+    Sysex ()
+      : _length (0xff)
+      , _received (0)
+      , _errors (0)
+    {
+    }
+
+    void start ()
+    {
+      _length = 0;
+      _sum = 0;
+    }
+
+    void data (uint8_t data)
+    {
+      // Past anything we know, or not ours
+      if (_length == 0xff)
+        return;
+
+      static const uint8_t header[] = { Sysex_manufacturer, Sysex_device };
+
+      if (_length < sizeof (header))
+      {
+        if (data != header[_length])
+        {
+          _length = 0xff;
+          return;
+        }
+      }
+
+      else if (_length == sizeof (header))
+      {
+        _command = data;
+      }
+
+      else
+      {
+        receive (_length - Sysex_header_size, data);
+      }
+
+      _length++;
+    }
+
+    // complete is false when another status byte cut the message short
+    void end (bool complete)
+    {
+      if (_length == 0xff)
+        return;
+
+      // Too short to tell whose it was
+      if (_length < Sysex_header_size)
+      {
+        _length = 0xff;
+        return;
+      }
+
+      uint8_t length = _length - Sysex_header_size;
+      bool    ok = false;
+
+      _length = 0xff;
+
+      if (complete && _command == Sysex_patch)
+      {
+        ok = length == Sysex_packed_size + 2
+          && (_sum & 0x7f) == 0
+          && TCallback::patch (_program, _patch);
+      }
+
+      else if (complete && _command == Sysex_parameter)
+      {
+        ok = length == sizeof (_values)
+          && TCallback::parameter (_values[0], _values[1], _values[2]);
+      }
+
+      if (ok)
+        _received++;
+      else
+        _errors++;
+    }
+
+    uint16_t received () const
+    {
+      return _received;
+    }
+
+    uint16_t errors () const
+    {
+      return _errors;
+    }
+
+  private:
+
+    // Byte i of the message body, after the command
+    void receive (uint8_t i, uint8_t data)
+    {
+      _sum += data;
+
+      if (_command == Sysex_parameter)
+      {
+        if (i < sizeof (_values))
+          _values[i] = data;
+
+        return;
+      }
+
+      if (i == 0)
+      {
+        _program = data;
+        return;
+      }
+
+      // Data bytes, group by group: one byte of top bits, then the rest
+      uint8_t  pos = i - 1;
+      uint8_t  group = pos / 8;
+      uint8_t  index = pos % 8;
+
+      if (pos >= Sysex_packed_size)
+        return;
+
+      if (index == 0)
+      {
+        _msbs = data;
+        return;
+      }
+
+      uint8_t offset = group * 7 + index - 1;
+
+      if (offset < Patch_size)
+        _patch.data[offset] = data | ((_msbs >> (index - 1)) & 1) << 7;
+    }
+
+    uint8_t  _length;   // bytes since f0, 0xff when not receiving
+    uint8_t  _command;
+    uint8_t  _program;
+    uint8_t  _msbs;
+    uint8_t  _sum;
+    uint8_t  _values[3];
+    Patch    _patch;
+    uint16_t _received;
+    uint16_t _errors;
+};
+
+#endif /* _SYSEX_H */
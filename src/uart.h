@@ -2,19 +2,45 @@
 #define _UART_H_
 
 #include "ringbuffer.h"
+#include "profile.h"
 
 #include <avr/io.h>
 #include <avr/interrupt.h>  
 #include <stdint.h>
 
-RingBuffer<uint8_t, 32> _buffer;
+// Receive ring, a power of two up to 128. The default covers MIDI; the
+// fast register streaming mode wants 128 (make stream) so that a display
+// redraw cannot overflow it.
+#ifndef UART_BUFFER_SIZE
+#define UART_BUFFER_SIZE 32
+#endif
+
+RingBuffer<uint8_t, UART_BUFFER_SIZE> _buffer;
+
+// Rate divider for the normal speed mode
+constexpr uint16_t uart_divider (uint32_t baud)
+{
+  return F_CPU / 16 / baud - 1;
+}
+
+// Receive health, kept under a fixed name for the simulator benchmarks.
+// Bytes are lost either because the ring was full or because the
+// interrupt came too late and the UART overwrote one (data overrun).
+struct Uart_stats
+{
+  uint16_t dropped;
+  uint16_t overruns;
+  uint8_t  high_water;
+};
+
+Uart_stats uart_stats;
 
 class Uart
 {
   public:
     Uart ()
     {
-      UBRR0 = 31;
+      UBRR0 = uart_divider (31250);
 
       UCSR0C = _BV (UCSZ01) | _BV (UCSZ00);
       UCSR0B = _BV (RXEN0)  | _BV (RXCIE0);
@@ -29,12 +55,42 @@ class Uart
     {
       return _buffer.read ();
     }
+
+    // Switches the bit rate and drops what was received at the old one
+    void set_baud (uint32_t baud)
+    {
+      UCSR0B = 0;
+      UBRR0 = uart_divider (baud);
+      UCSR0B = _BV (RXEN0) | _BV (RXCIE0);
+
+      while (available ())
+      {
+        receive ();
+      }
+    }
 };
 
 ISR(USART_RX_vect) 
 {
+  PROFILE_SCOPE (Probe_uart_isr);
+
+  if (UCSR0A & _BV (DOR0))
+    uart_stats.overruns++;
+
   char data = UDR0;
+
+  if (_buffer.full ())
+  {
+    uart_stats.dropped++;
+    return;
+  }
+
   _buffer.write (data);
+
+  auto count = _buffer.count ();
+
+  if (count > uart_stats.high_water)
+    uart_stats.high_water = count;
 }
     
 
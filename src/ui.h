@@ -2,33 +2,47 @@
 #define _UI_H
 
 #include "encoder.h"
-#include "ringbuffer.h"
 #include "menu.h"
 #include "oled.h"
 #include "settings.h"
+#include "profile.h"
 
-enum Event_type
+#include <util/atomic.h>
+#include <avr/pgmspace.h>
+
+// Encoder acceleration. The fastest inter-detent time seen between two
+// updates, in Timer0 ticks (~1 ms), selects one of four speeds, and the
+// curve for the edited value's range turns that into a step multiplier.
+const uint8_t acceleration_thresholds[] PROGMEM = { 40, 20, 10 };
+
+struct Acceleration_curve
 {
-  ENCODER_ROTATE,
-  ENCODER_PRESSED,
+  uint8_t max_range;
+  uint8_t factor[4];
 };
 
-struct Input_event
+const Acceleration_curve acceleration_curves[] PROGMEM =
 {
-  Event_type type;
-  int8_t     data;
-  uint8_t    id;
+  {  15, { 1, 1, 1, 1 } },
+  {  31, { 1, 1, 2, 2 } },
+  { 255, { 1, 2, 4, 8 } },
 };
 
+template<class TOled>
 class Ui
 {
   public:
-    Ui (Encoder & enc1, Encoder & enc2, Menu & menu, Oled & oled, Settings & settings)
+    Ui (Encoder & enc1, Encoder & enc2, Menu & menu, TOled & oled, Settings & settings)
       : _enc1 (enc1)
       , _enc2 (enc2)
       , _menu (menu)
       , _oled (oled)
       , _settings (settings)
+      , _delta {0, 0}
+      , _interval (0xff)
+      , _pressed (0)
+      , _since (0xff)
+      , _dirty (true)
     {
     }
 
@@ -40,112 +54,172 @@ class Ui
     {
     }
 
-    // Called from interrupt
+    // Called from timer interrupt. Presses are latched and the time since
+    // the last detent is counted for acceleration; update () consumes
+    // whatever arrived since the last call.
     void read_inputs ()
     {
       _enc1.debounce ();
+      _enc2.debounce ();
 
-      auto e1 = _enc1.read ();
-
-      if (e1 == 88)
-      {  
-        Input_event e;
-        e.type = ENCODER_PRESSED;
-        e.id = 1;
-        _ringbuffer.write (e);
+      if (_enc1.pressed ())
+      {
+        _pressed |= _BV (0);
       }
 
-      else
+      if (_enc2.pressed ())
       {
-        if (e1 != 0)
-        {
-          Input_event e;
-          e.type = ENCODER_ROTATE;
-          e.data = e1;
-          e.id = 1;
-          _ringbuffer.write (e);
-        }
+        _pressed |= _BV (1);
       }
 
-      auto e2 = _enc2.read ();
-       
-      if (e2 == 88)
-      {  
-        Input_event e;
-        e.type = ENCODER_PRESSED;
-        e.id = 2;
-        _ringbuffer.write (e);
-      } 
-
-      else
+      if (_since < 0xff)
       {
-        if (e2 != 0)
-        {
-          Input_event e;
-          e.type = ENCODER_ROTATE;
-          e.data = e2;
-          e.id = 2;
-          _ringbuffer.write (e);
-        } 
+        _since++;
       }
+    }
 
+    // Called from pin change interrupt
+    void decode_inputs ()
+    {
+      accumulate (0, _enc1.decode ());
+      accumulate (1, _enc2.decode ());
     }
 
     void update ()
     {
-      if (!_ringbuffer.available ())
+      int8_t  navigate;
+      int8_t  edit;
+      uint8_t interval;
+      uint8_t pressed;
+
+      ATOMIC_BLOCK (ATOMIC_RESTORESTATE)
       {
-        return;
+        navigate = _delta[0];
+        edit     = _delta[1];
+        interval = _interval;
+        pressed  = _pressed;
+
+        _delta[0] = 0;
+        _delta[1] = 0;
+        _interval = 0xff;
+        _pressed  = 0;
       }
 
-      auto event = _ringbuffer.read ();
+      if (!navigate && !edit && !pressed)
+      {
+        return;
+      }
 
-      switch (event.type)
+      if (navigate)
       {
-        case ENCODER_ROTATE:
-          switch (event.id)
-          {
-            case 1:
-              _menu.navigate (event.data);
-              break;
+        _menu.navigate (navigate);
+      }
 
-            case 2:
-              _menu.edit (event.data);
-              break;
+      if (edit)
+      {
+        _menu.edit (accelerate (edit, interval, _menu.range ()));
+      }
 
-            default:
-              break;
-          }
+      if (pressed & _BV (0))
+      {
+        _settings.save ();
+      }
 
-          break;
+      if (pressed & _BV (1))
+      {
+        learn ();
+      }
 
-        case ENCODER_PRESSED:
-          switch (event.id)
-          {
-            case 1:
-              _settings.save ();
-              break;
+      _dirty = true;
+    }
 
-            default:
-              break;
-          }
+    // Marks the screen for redrawing, e.g. after a value changed from MIDI
+    void invalidate ()
+    {
+      _dirty = true;
+    }
 
-        default:
-          break;
+    void render ()
+    {
+      if (!_dirty)
+      {
+        return;
       }
-      //_oled.clear ();
+
+      PROFILE_SCOPE (Probe_render);
+      _dirty = false;
       _menu.render ();
-      //_oled.render ();
     }
 
   private:
 
-    RingBuffer<Input_event, 16> _ringbuffer;
+    // The edit switch arms controller learning for the selected patch
+    // parameter; a second press clears its binding
+    void learn ()
+    {
+      uint8_t setting;
+      uint8_t voice;
+
+      if (_menu.selected (setting, voice) && setting < Num_settings)
+      {
+        _settings.controls ().learn (cc_target (setting, voice));
+      }
+    }
+
+    void accumulate (uint8_t id, int8_t e)
+    {
+      if (e == 0)
+      {
+        return;
+      }
+
+      if (id == 1)
+      {
+        if (_since < _interval)
+          _interval = _since;
+
+        _since = 0;
+      }
+
+      int8_t delta = _delta[id] + e;
+
+      if (delta > -100 && delta < 100)
+      {
+        _delta[id] = delta;
+      }
+    }
+
+    static int8_t accelerate (int8_t steps, uint8_t interval, uint8_t range)
+    {
+      uint8_t speed = 0;
+
+      while (speed < 3 && interval < pgm_read_byte (& acceleration_thresholds[speed]))
+      {
+        speed++;
+      }
+
+      const Acceleration_curve * curve = acceleration_curves;
+
+      while (range > pgm_read_byte (& curve->max_range))
+      {
+        curve++;
+      }
+
+      int16_t result = steps * pgm_read_byte (& curve->factor[speed]);
+      return result < -127 ? -127 : result > 127 ? 127 : result;
+    }
+
     Encoder &  _enc1;
     Encoder &  _enc2;
     Menu &     _menu;
-    Oled &     _oled;
+    TOled &    _oled;
     Settings & _settings;
+
+    volatile int8_t  _delta[2];
+    volatile uint8_t _interval;
+    volatile uint8_t _pressed;
+    uint8_t          _since;
+    bool             _dirty;
 };
 
 #endif /* _UI_H */
@@ -0,0 +1,196 @@
+#include "check.h"
+#include "encoder.h"
+#include "sid_bus.h"
+#include "../bench/bench.h"
+
+// What bench/bench.cc reads from the pins under simavr, checked against
+// the firmware code driving them: the SID bus as SidHandler bit bangs it
+// and the encoder edges as Encoder decodes them.
+
+static_assert (sizeof (probe_names) / sizeof (probe_names[0]) == Num_probes, "probe names out of step with enum Probe");
+
+using Synth = host::Synth<host::Sid_registers>;
+using Bus_synth = host::Synth<SidHandler>;
+
+static Sid_bus bus;
+static uint8_t decoded[Last_register];
+static uint32_t writes;
+static Note_latency * latency;
+
+// Every PORTD write, reported pin by pin as simavr would
+static void watch (uint8_t port)
+{
+  uint8_t address;
+  uint8_t data;
+
+  bus.data (port >> hc595_data & 1);
+  bus.clock (port >> hc595_clk & 1);
+
+  if (bus.select (port >> sid_cs & 1, address, data))
+  {
+    if (address < Last_register)
+      decoded[address] = data;
+
+    if (latency)
+      latency->write (address, data, _host_time);
+
+    writes++;
+  }
+}
+
+static void sid_bus ()
+{
+  // As main () leaves it before the first write
+  bit::set (PORTD, sid_cs);
+  PORTD.watch = watch;
+  writes = 0;
+
+  for (uint16_t i = 0; i < 0x200; ++i)
+  {
+    uint8_t address = i % Last_register;
+    uint8_t data = i * 37;
+
+    SidHandler::write (address, data);
+    CHECK (writes == i + 1u);
+    CHECK (decoded[address] == data);
+  }
+
+  // A note and a program change through the engine: the bus carries what
+  // the register file device gets
+  const std::vector<uint8_t> bytes { 0x90, 60, 100, 0xc0, Num_patches + 1, 0xd0, 40, 0x91, 72, 90 };
+
+  Synth::init ();
+  play (bytes);
+
+  memset (decoded, 0, sizeof (decoded));
+  Bus_synth::init ();
+  host::play<SidHandler> (bytes.data (), bytes.size ());
+
+  CHECK (memcmp (decoded, host::Sid_registers::registers, sizeof (decoded)) == 0);
+  PORTD.watch = nullptr;
+}
+
+// The bench turns a knob by setting both contacts for each quarter step;
+// the firmware sees one pin change and decodes one detent per half cycle
+static void encoder ()
+{
+  Encoder enc (DDRC, PORTC, PINC, PCMSK1, PC0, PC1, PC4);
+  PINC = _BV (PC0) | _BV (PC1) | _BV (PC4);
+  enc.init ();
+
+  for (auto sequence : { encoder_cw, encoder_ccw })
+  {
+    int detents = 0;
+
+    for (uint8_t d = 0; d < 6; ++d)
+    {
+      for (uint8_t q = 0; q < 2; ++q)
+      {
+        uint8_t state = sequence[(d & 1) * 2 + q];
+        PINC = (state & 2 ? _BV (PC0) : 0) | (state & 1 ? _BV (PC1) : 0) | _BV (PC4);
+        detents += enc.decode ();
+      }
+    }
+
+    CHECK (detents == (sequence == encoder_cw ? 6 : -6));
+  }
+}
+
+// Notes through the engine are served by their own frequency writes, in
+// order. The morph and program changes under the held note write none.
+static void note_latency ()
+{
+  Note_latency played;
+
+  bit::set (PORTD, sid_cs);
+  PORTD.watch = watch;
+  Bus_synth::init ();
+  Bus_synth::morph.set_enabled (true);
+
+  // Init writes the default patch's frequency; the notes come after
+  latency = & played;
+
+  for (uint8_t i = 0; i < 24; ++i)
+  {
+    const uint8_t note = 60 + i % 12;
+    const uint8_t on[] = { 0x90, note, 100, 0xb0, 1, (uint8_t) (i * 5) };
+
+    played.note (_host_time + 3 * host::Midi_us_per_byte - 1, note_frequency (note));
+    host::play<SidHandler> (on, sizeof (on));
+
+    if (i % 4 == 3)
+    {
+      const uint8_t change[] = { 0xc0, (uint8_t) (Num_patches + i % 3) };
+      host::play<SidHandler> (change, sizeof (change));
+    }
+  }
+
+  CHECK (played.latencies.size () == 24);
+  CHECK (played.coalesced == 0);
+  CHECK (played.stray == 0);
+  CHECK (played.pending.empty ());
+
+  for (auto l : played.latencies)
+  {
+    CHECK (l == 1);
+  }
+
+  latency = nullptr;
+  PORTD.watch = nullptr;
+
+  // Received before the write: the newest one with the written frequency
+  // is served, the older ones were coalesced; the later one waits
+  Note_latency n;
+  n.note (100, 0x1234);
+  n.note (110, 0x2345);
+  n.note (120, 0x3456);
+  n.note (200, 0x3456);
+
+  n.write (Voice_1_ad, 0x34, 145);
+  n.write (Freq_lo, 0x56, 150);
+  CHECK (n.latencies.empty ());
+  n.write (Freq_hi, 0x34, 160);
+  CHECK (n.latencies.size () == 1 && n.latencies[0] == 40);
+  CHECK (n.coalesced == 2);
+  CHECK (n.pending.size () == 1);
+  CHECK (n.stray == 0);
+
+  n.write (Freq_lo, 0x56, 250);
+  CHECK (n.latencies.size () == 2 && n.latencies[1] == 50);
+  CHECK (n.coalesced == 2);
+
+  // Frequency writes no note asked for: a whole word, and a low byte
+  // on its own
+  n.write (Freq_hi, 0x12, 300);
+  CHECK (n.stray == 1);
+  n.write (Freq_lo, 0x00, 310);
+  n.write (Voice_1_ad, 0x34, 320);
+  CHECK (n.stray == 2);
+}
+
+static void percentiles ()
+{
+  std::vector<uint64_t> sorted;
+  CHECK (percentile (sorted, 50) == 0);
+
+  for (uint64_t v = 1; v <= 100; ++v)
+  {
+    sorted.push_back (v);
+  }
+
+  CHECK (percentile (sorted, 0) == 1);
+  CHECK (percentile (sorted, 50) == 50);
+  CHECK (percentile (sorted, 99) == 99);
+  CHECK (percentile (sorted, 100) == 100);
+}
+
+int main ()
+{
+  sid_bus ();
+  encoder ();
+  note_latency ();
+  percentiles ();
+
+  printf ("bench_test: %s\n", failures ? "FAILED" : "ok");
+  return failures ? 1 : 0;
+}
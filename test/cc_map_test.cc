@@ -0,0 +1,236 @@
+#include "check.h"
+
+// Control changes through Midi<> into the synth: bound controllers and
+// NRPN land on their parameter scaled to its range, 14 bit values reach
+// the fine cutoff bits, learned bindings are stored with the program.
+
+using Synth = host::Synth<host::Sid_registers>;
+
+static void default_bindings ()
+{
+  Synth::init ();
+
+  // Brightness and timbre, on any channel
+  play ({ 0xb0, 74, 0x40, 0xb5, 71, 0x7f });
+  CHECK (Synth::settings.get (FILTER_CUTOFF, 0) == 0x40);
+  CHECK (Synth::settings.get (FILTER_RESONANCE, 0) == 15);
+  CHECK (reg (Filter_cutoff_hi) == 0x40);
+  CHECK (reg (Filter_res_en) >> 4 == 15);
+
+  // Scaled to the range: 0-7 is the lowest resonance, 8-15 the next
+  play ({ 0xb0, 71, 7 });
+  CHECK (Synth::settings.get (FILTER_RESONANCE, 0) == 0);
+  play ({ 0xb0, 71, 8 });
+  CHECK (Synth::settings.get (FILTER_RESONANCE, 0) == 1);
+
+  // Unbound controllers change nothing
+  auto before = Synth::settings.patch ();
+  play ({ 0xb0, 20, 0x7f, 0xb0, 7, 0x00 });
+  CHECK (Synth::settings.patch () == before);
+}
+
+static void fine_cutoff ()
+{
+  Synth::init ();
+  auto & controls = Synth::settings.controls ();
+
+  // CC 19 with its LSB on CC 51
+  controls.bind (19, cc_target (FILTER_CUTOFF, 0));
+  play ({ 0xb0, 19, 0x55, 51, 0x70 });
+  CHECK (Synth::settings.get (FILTER_CUTOFF, 0) == 0x55);
+  CHECK (reg (Filter_cutoff_hi) == 0x55);
+  CHECK (reg (Filter_cutoff_lo) == 0x07);
+
+  // A new MSB drops the fine bits
+  play ({ 0xb0, 19, 0x20 });
+  CHECK (reg (Filter_cutoff_hi) == 0x20);
+  CHECK (reg (Filter_cutoff_lo) == 0x00);
+
+  // NRPN 0/9, data entry MSB and LSB
+  play ({ 0xb0, 99, 0, 98, FILTER_CUTOFF, 6, 0x12, 38, 0x30 });
+  CHECK (Synth::settings.get (FILTER_CUTOFF, 0) == 0x12);
+  CHECK (reg (Filter_cutoff_hi) == 0x12);
+  CHECK (reg (Filter_cutoff_lo) == 0x03);
+}
+
+static void nrpn ()
+{
+  Synth::init ();
+
+  // Voice in the MSB, setting in the LSB
+  play ({ 0xb0, 99, 2, 98, VOICE_ATTACK, 6, 0x7f });
+  CHECK (Synth::settings.get (VOICE_ATTACK, 2) == 15);
+  CHECK (reg (Voice_3_ad) >> 4 == 15);
+
+  // Running status keeps the selection
+  play ({ 0xb0, 6, 0x00, 6, 0x48 });
+  CHECK (Synth::settings.get (VOICE_ATTACK, 2) == 9);
+
+  // Voices or settings that do not exist, and an RPN, select nothing
+  auto before = Synth::settings.patch ();
+  play ({ 0xb0, 99, 1, 98, FILTER_CUTOFF, 6, 0x7f });
+  play ({ 0xb0, 99, 0, 98, Num_settings, 6, 0x7f });
+  play ({ 0xb0, 99, 0, 98, 0x7f, 6, 0x7f });
+  play ({ 0xb0, 99, 0, 98, VOICE_DECAY, 101, 0, 100, 0, 6, 0x7f });
+  CHECK (Synth::settings.patch () == before);
+}
+
+static void learn ()
+{
+  Cc_map map;
+  Cc_value c;
+  auto target = cc_target (VOICE_SUSTAIN, 1);
+
+  // Data entry and LSBs are passed over, the next controller is bound
+  map.learn (target);
+  CHECK (!map.control_change (6, 0x10, c));
+  CHECK (!map.control_change (40, 0x10, c));
+  CHECK (map.learning () == target);
+  CHECK (map.control_change (16, 0x10, c));
+  CHECK (map.learning () == No_binding);
+  CHECK (map.find (target) == 16);
+  CHECK (c.setting == VOICE_SUSTAIN && c.voice == 1 && c.value == 0x10 << 7);
+
+  // Moving a bound controller to another target
+  map.learn (cc_target (VOICE_RELEASE, 0));
+  map.control_change (16, 0, c);
+  CHECK (map.find (target) == No_binding);
+  CHECK (c.setting == VOICE_RELEASE);
+
+  // A second press clears the binding
+  map.learn (cc_target (VOICE_RELEASE, 0));
+  map.learn (cc_target (VOICE_RELEASE, 0));
+  CHECK (map.learning () == No_binding);
+  CHECK (!map.control_change (16, 0, c));
+
+  // Full
+  for (uint8_t cc = 20; cc < 20 + Max_cc_bindings; ++cc)
+  {
+    CHECK (map.bind (cc, cc_target (VOICE_DECAY, 0)));
+  }
+
+  CHECK (!map.bind (64, cc_target (VOICE_DECAY, 0)));
+  CHECK (map.bind (20, cc_target (VOICE_ATTACK, 0)));
+}
+
+static void stored_with_program ()
+{
+  Synth::init ();
+
+  Synth::settings.select (3);
+  Synth::settings.controls ().bind (16, cc_target (VOICE_PW, 0));
+  Synth::settings.save ();
+
+  while (Synth::settings.saving ())
+  {
+    EE_READY_vect ();
+    Synth::settings.poll ();
+  }
+
+  // Other programs keep the defaults
+  Synth::settings.select (4);
+  CHECK (Synth::settings.controls ().find (cc_target (VOICE_PW, 0)) == No_binding);
+  CHECK (Synth::settings.controls ().find (cc_target (FILTER_CUTOFF, 0)) == 74);
+
+  Synth::settings.select (3);
+  CHECK (Synth::settings.controls ().find (cc_target (VOICE_PW, 0)) == 16);
+
+  // A patch from a librarian leaves them alone
+  Patch patch;
+  Synth::settings.read (Num_patches, patch);
+  CHECK (Synth::settings.store (3, patch));
+
+  while (Synth::settings.saving ())
+  {
+    EE_READY_vect ();
+    Synth::settings.poll ();
+  }
+
+  Synth::settings.select (4);
+  Synth::settings.select (3);
+  CHECK (Synth::settings.patch () == patch);
+  CHECK (Synth::settings.controls ().find (cc_target (VOICE_PW, 0)) == 16);
+}
+
+// Repeated values that land on the same step write nothing and do not
+// redraw; CC 1 moves the morph unless it is bound
+static void only_changes ()
+{
+  Synth::init ();
+
+  play ({ 0xb0, 71, 3 });
+  auto writes = host::Sid_registers::writes;
+  auto redraws = Synth::redraws;
+
+  play ({ 0xb0, 71, 5, 71, 7 });
+  CHECK (host::Sid_registers::writes == writes);
+  CHECK (Synth::redraws == redraws);
+
+  play ({ 0xb0, 71, 8 });
+  CHECK (host::Sid_registers::writes == writes + 1);
+  CHECK (Synth::redraws == redraws + 1);
+
+  // Between presets 1 and 2, all the way to the second
+  Synth::morph.set_enabled (true);
+  Synth::select_morph_source (0, Num_patches);
+  Synth::select_morph_source (1, Num_patches + 1);
+  Patch b;
+  memcpy_P (& b, & presets[1].patch, sizeof (b));
+  Register_image image;
+  image.decode (b);
+
+  play ({ 0xb0, 1, 127 });
+  CHECK (Synth::morph.position () == 127);
+  CHECK (reg (Voice_1_ad) == image.regs[Voice_1_ad]);
+  CHECK (reg (Voice_1_sr) == image.regs[Voice_1_sr]);
+
+  // Bound, it is a controller like any other
+  Synth::settings.controls ().bind (1, cc_target (VOICE_RELEASE, 2));
+  play ({ 0xb0, 1, 0 });
+  CHECK (Synth::morph.position () == 127);
+  CHECK (Synth::settings.get (VOICE_RELEASE, 2) == 0);
+}
+
+// Program changes take the bindings from the program cache. A learned
+// binding is kept once saved, even when the program was cached before.
+static void cached_bindings ()
+{
+  Synth::init ();
+
+  play ({ 0xc0, 3 });
+  Synth::settings.controls ().learn (cc_target (VOICE_PW, 0));
+  play ({ 0xb0, 16, 0x40 });
+  CHECK (Synth::settings.controls ().find (cc_target (VOICE_PW, 0)) == 16);
+  Synth::settings.save ();
+  settle ();
+
+  play ({ 0xc0, 4, 0xc0, 3 });
+  CHECK (Synth::settings.controls ().find (cc_target (VOICE_PW, 0)) == 16);
+
+  // Not saved, it goes with the program like any other edit
+  Synth::settings.controls ().bind (17, cc_target (VOICE_PW, 1));
+  play ({ 0xc0, 4, 0xc0, 3 });
+  CHECK (Synth::settings.controls ().find (cc_target (VOICE_PW, 1)) == No_binding);
+  CHECK (Synth::settings.controls ().find (cc_target (VOICE_PW, 0)) == 16);
+
+  // Presets and unstored programs have the defaults
+  play ({ 0xc0, 4 });
+  CHECK (Synth::settings.controls ().find (cc_target (VOICE_PW, 0)) == No_binding);
+  CHECK (Synth::settings.controls ().find (cc_target (FILTER_CUTOFF, 0)) == 74);
+  play ({ 0xc0, Num_patches + 2 });
+  CHECK (Synth::settings.controls ().find (cc_target (FILTER_RESONANCE, 0)) == 71);
+}
+
+int main ()
+{
+  default_bindings ();
+  fine_cutoff ();
+  nrpn ();
+  learn ();
+  stored_with_program ();
+  only_changes ();
+  cached_bindings ();
+
+  printf ("cc_map_test: %s\n", failures ? "FAILED" : "ok");
+  return failures ? 1 : 0;
+}
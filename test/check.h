@@ -0,0 +1,37 @@
+#ifndef _TEST_CHECK_H
+#define _TEST_CHECK_H
+
+// Harness shared by the host tests. CHECK reports a failed condition with
+// its line and counts it; main prints the verdict from failures. play ()
+// and reg () drive the firmware's Engine on the register file device.
+
+#include <stdio.h>
+#include <vector>
+#include "synth.h"
+
+static int failures = 0;
+
+#define CHECK(cond) \
+  do { if (!(cond)) { printf ("%s:%d: %s\n", __FILE__, __LINE__, #cond); failures++; } } while (0)
+
+// Plays MIDI bytes at 31250 baud, then one more frame
+inline void play (const std::vector<uint8_t> & bytes)
+{
+  host::play<host::Sid_registers> (bytes.data (), bytes.size ());
+}
+
+inline uint8_t reg (uint8_t address)
+{
+  return host::Sid_registers::registers[address];
+}
+
+// Runs frames and EEPROM write cycles until the bank is idle
+inline void settle ()
+{
+  while (host::Synth<host::Sid_registers>::settings.saving ())
+  {
+    host::Synth<host::Sid_registers>::step ();
+  }
+}
+
+#endif /* _TEST_CHECK_H */
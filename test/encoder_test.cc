@@ -0,0 +1,129 @@
+#include <avr/io.h>
+#include <stdlib.h>
+#include "encoder.h"
+#include "check.h"
+
+// Drives an Encoder through simulated pin changes. Every edge raises the
+// pin change interrupt, so decode () runs once per edge no matter how fast
+// the knob turns.
+
+static const uint8_t cw[] = { 0, 2, 3, 1 };
+
+struct Knob
+{
+  Knob ()
+    : enc (DDRC, PORTC, PINC, PCMSK1, PC0, PC1, PC4)
+    , phase (0)
+    , detents (0)
+  {
+    set (0);
+    enc.init ();
+  }
+
+  void set (uint8_t state)
+  {
+    PINC = (PINC & ~ 3) | ((state & 2) ? _BV (PC0) : 0) | ((state & 1) ? _BV (PC1) : 0);
+  }
+
+  void edge ()
+  {
+    detents += enc.decode ();
+  }
+
+  // One quadrature step, changing a single input
+  void step (int8_t direction)
+  {
+    phase = (phase + direction) & 3;
+    set (cw[phase]);
+    edge ();
+  }
+
+  // A contact that chatters before settling on the next state
+  void bouncy_step (int8_t direction, uint8_t bounces)
+  {
+    uint8_t from = cw[phase];
+    uint8_t to = cw[(phase + direction) & 3];
+
+    for (uint8_t i = 0; i < bounces; ++i)
+    {
+      set (to);
+      edge ();
+      set (from);
+      edge ();
+    }
+
+    step (direction);
+  }
+
+  Encoder enc;
+  uint8_t phase;
+  int     detents;
+};
+
+static void fast_rotation ()
+{
+  Knob knob;
+
+  for (int i = 0; i < 4000; ++i)
+    knob.step (1);
+
+  CHECK (knob.detents == 2000);
+
+  for (int i = 0; i < 4000; ++i)
+    knob.step (-1);
+
+  CHECK (knob.detents == 0);
+}
+
+static void reversals ()
+{
+  Knob knob;
+
+  for (int i = 0; i < 1000; ++i)
+  {
+    knob.step (1);
+    knob.step (1);
+    knob.step (-1);
+    knob.step (1);
+  }
+
+  CHECK (knob.detents == 1000);
+}
+
+static void contact_bounce ()
+{
+  Knob knob;
+  srand (1);
+
+  for (int i = 0; i < 4000; ++i)
+    knob.bouncy_step (1, rand () % 4);
+
+  CHECK (knob.detents == 2000);
+}
+
+static void invalid_transitions ()
+{
+  Knob knob;
+
+  // Both inputs flipping at once carries no direction and must not count
+  for (int i = 0; i < 100; ++i)
+  {
+    knob.set (3);
+    knob.edge ();
+    knob.set (0);
+    knob.edge ();
+  }
+
+  CHECK (knob.detents == 0);
+}
+
+int main ()
+{
+  fast_rotation ();
+  reversals ();
+  contact_bounce ();
+  invalid_transitions ();
+
+  printf ("encoder_test: %s\n", failures ? "FAILED" : "ok");
+  return failures ? 1 : 0;
+}
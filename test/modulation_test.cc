@@ -0,0 +1,161 @@
+#include "check.h"
+#include "sysex_messages.h"
+
+// Velocity and pressure through Midi<> into the synth: routed
+// destinations move with the source in the parameter's range, the patch
+// itself does not change, and voices without routes play as before.
+
+using Synth = host::Synth<host::Sid_registers>;
+
+static void route (Setting dest, Setting depth, uint8_t voice, Mod_destination to, uint8_t amount)
+{
+  Synth::settings.set (dest, voice, to);
+  Synth::settings.set (depth, voice, amount);
+}
+
+static void velocity ()
+{
+  Synth::init ();
+
+  // Default patch: sustain 15, attack 0, release 8
+  Synth::settings.set (VOICE_SUSTAIN, 0, 4);
+  Synth::settings.set (VOICE_ATTACK, 1, 12);
+  route (VOICE_VELOCITY_DEST, VOICE_VELOCITY_DEPTH, 0, Mod_sustain, 15);
+  route (VOICE_VELOCITY_DEST, VOICE_VELOCITY_DEPTH, 1, Mod_attack, 8);
+  auto patch = Synth::settings.patch ();
+
+  // 127 * 15 >> 4 = 119, 119 * 16 >> 7 = 14 added, clamped at 15
+  play ({ 0x90, 60, 127 });
+  CHECK (reg (Voice_1_sr) >> 4 == 15);
+
+  // 64 * 15 >> 4 = 60, 60 * 16 >> 7 = 7
+  play ({ 0x80, 60, 0, 0x90, 60, 64 });
+  CHECK (reg (Voice_1_sr) >> 4 == 11);
+
+  // Quietly, the patch value
+  play ({ 0x90, 60, 1 });
+  CHECK (reg (Voice_1_sr) >> 4 == 4);
+
+  // Attack gets shorter: 100 * 8 >> 4 = 50, 50 * 16 >> 7 = 6
+  play ({ 0x91, 60, 100 });
+  CHECK (reg (Voice_2_ad) >> 4 == 6);
+  CHECK ((reg (Voice_2_ad) & 0x0f) == 8);
+
+  // Voice 3 has no routes
+  play ({ 0x92, 60, 127 });
+  CHECK (reg (Voice_3_sr) == 0xf8);
+  CHECK (reg (Voice_3_ad) == 0x08);
+
+  CHECK (Synth::settings.patch () == patch);
+}
+
+static void pressure ()
+{
+  Synth::init ();
+
+  Synth::settings.set (VOICE_PW, 2, 32);
+  route (VOICE_PRESSURE_DEST, VOICE_PRESSURE_DEPTH, 2, Mod_pulsewidth, 15);
+
+  // PW is 7 bits at register bit 5: 32 + (119 * 128 >> 7) clamps at 127
+  play ({ 0x92, 60, 100, 0xd2, 127 });
+  CHECK ((reg (Voice_3_pw_hi) << 8 | reg (Voice_3_pw_lo)) >> 5 == 127);
+
+  // Key pressure counts for the channel, running status too
+  play ({ 0xa2, 60, 0, 60, 32 });
+  CHECK ((reg (Voice_3_pw_hi) << 8 | reg (Voice_3_pw_lo)) >> 5 == 32 + 30);
+
+  // Other channels' pressure leaves voice 3 alone
+  play ({ 0xd0, 127 });
+  CHECK ((reg (Voice_3_pw_hi) << 8 | reg (Voice_3_pw_lo)) >> 5 == 32 + 30);
+}
+
+static void shared_cutoff ()
+{
+  Synth::init ();
+
+  Synth::settings.set (FILTER_CUTOFF, 0, 20);
+  route (VOICE_VELOCITY_DEST, VOICE_VELOCITY_DEPTH, 0, Mod_cutoff, 8);
+  route (VOICE_PRESSURE_DEST, VOICE_PRESSURE_DEPTH, 1, Mod_cutoff, 15);
+
+  // 127 * 8 >> 4 = 63 added
+  play ({ 0x90, 60, 127 });
+  CHECK (reg (Filter_cutoff_hi) == 20 + 63);
+
+  // Voice 2 pushes further: 100 * 15 >> 4 = 93
+  play ({ 0xd1, 100 });
+  CHECK (reg (Filter_cutoff_hi) == 20 + 93);
+
+  // Released, the cutoff goes back to voice 1's amount
+  play ({ 0xd1, 0 });
+  CHECK (reg (Filter_cutoff_hi) == 20 + 63);
+
+  // Both sources of one voice add up
+  route (VOICE_PRESSURE_DEST, VOICE_PRESSURE_DEPTH, 0, Mod_cutoff, 4);
+  play ({ 0xd0, 64 });
+  CHECK (reg (Filter_cutoff_hi) == 20 + 63 + 16);
+}
+
+static void fixed_point ()
+{
+  Synth::init ();
+
+  // Every velocity and depth stays in range and never lowers the value
+  for (uint8_t depth = 0; depth < 16; ++depth)
+  {
+    route (VOICE_VELOCITY_DEST, VOICE_VELOCITY_DEPTH, 0, Mod_cutoff, depth);
+    uint8_t last = 0;
+
+    for (uint8_t v = 1; v < 128; ++v)
+    {
+      play ({ 0x90, 60, v });
+      CHECK (reg (Filter_cutoff_hi) <= 127);
+      CHECK (reg (Filter_cutoff_hi) >= last);
+      last = reg (Filter_cutoff_hi);
+    }
+  }
+}
+
+// With the morph engaged the offsets go on the blend, and stay on top of
+// it as the morph and the program change under a held note
+static void morphed ()
+{
+  Synth::init ();
+
+  Patch a = Synth::settings.patch ();
+  set_value (a, get_parameter (FILTER_CUTOFF), 0, 20);
+  set_value (a, get_parameter (VOICE_VELOCITY_DEST), 0, Mod_cutoff);
+  set_value (a, get_parameter (VOICE_VELOCITY_DEPTH), 0, 8);
+  Patch b = a;
+  set_value (b, get_parameter (FILTER_CUTOFF), 0, 100);
+
+  play (host::patch_message (1, a));
+  settle ();
+  play (host::patch_message (2, b));
+  settle ();
+  Synth::select_morph_source (0, 1);
+  Synth::select_morph_source (1, 2);
+  Synth::morph.set_enabled (true);
+
+  // Halfway: 20 + (80 * 65 + 64 >> 7) = 61, and 127 * 8 >> 4 = 63 on top
+  play ({ 0xb0, 1, 64, 0x90, 60, 127 });
+  CHECK (reg (Filter_cutoff_hi) == 61 + 63);
+
+  play ({ 0xb0, 1, 0 });
+  CHECK (reg (Filter_cutoff_hi) == 20 + 63);
+
+  // The next program has the route too
+  play ({ 0xc0, 2 });
+  CHECK (reg (Filter_cutoff_hi) == 127);
+}
+
+int main ()
+{
+  velocity ();
+  pressure ();
+  shared_cutoff ();
+  fixed_point ();
+  morphed ();
+
+  printf ("modulation_test: %s\n", failures ? "FAILED" : "ok");
+  return failures ? 1 : 0;
+}
@@ -0,0 +1,159 @@
+#include "check.h"
+#include "sysex_messages.h"
+
+// The morph on CC 1 through Midi<> into the synth: it only plays while
+// enabled, takes over whatever the registers hold after a program change,
+// leaves the notes alone, and the blend being played is what SAVE stores.
+
+using Synth = host::Synth<host::Sid_registers>;
+
+static Register_image image (const Patch & patch)
+{
+  Register_image image;
+  image.decode (patch);
+  return image;
+}
+
+static Patch preset (uint8_t index)
+{
+  Patch patch;
+  memcpy_P (& patch, & presets[index].patch, sizeof (patch));
+  return patch;
+}
+
+// Every register the patch sets; frequencies and gates belong to notes,
+// which held () checks
+static bool playing (const Patch & patch)
+{
+  auto expected = image (patch);
+
+  for (uint8_t r = Voice_1_freq_lo; r < Last_register; ++r)
+  {
+    uint8_t field = r < Filter_cutoff_lo ? r % 7 : 7;
+    uint8_t mask = field == Voice_1_control ? ~ Gate_bit : 0xff;
+
+    if (field > Voice_1_freq_hi && (reg (r) & mask) != (expected.regs[r] & mask))
+      return false;
+  }
+
+  return true;
+}
+
+// A program change replaces every register; the next move of the morph
+// puts all of its blend back, not only what changed since the last one
+static void resync ()
+{
+  Synth::init ();
+  Synth::morph.set_enabled (true);
+  Synth::select_morph_source (0, Num_patches);
+  Synth::select_morph_source (1, Num_patches + 1);
+
+  play ({ 0xb0, 1, 127 });
+  CHECK (playing (preset (1)));
+
+  play ({ 0xc0, Num_patches + 2 });
+  CHECK (playing (preset (2)));
+
+  play ({ 0xb0, 1, 127 });
+  CHECK (playing (preset (1)));
+
+  // The same after a sysex edit buffer
+  play (host::patch_message (Sysex_edit_buffer, preset (3)));
+  CHECK (playing (preset (3)));
+  play ({ 0xb0, 1, 0 });
+  CHECK (playing (preset (0)));
+}
+
+// The blend is an edit of the current program
+static void save_blend ()
+{
+  Synth::init ();
+  Synth::morph.set_enabled (true);
+  Synth::select_morph_source (0, Num_patches);
+  Synth::select_morph_source (1, Num_patches + 1);
+
+  play ({ 0xb0, 1, 64 });
+  Patch blend = Synth::settings.patch ();
+  Synth::morph.blend (blend);
+  CHECK (Synth::settings.patch () == blend);
+  CHECK (playing (blend));
+
+  CHECK (Synth::settings.save ());
+  settle ();
+
+  Patch stored;
+  Synth::settings.read (0, stored);
+  CHECK (stored == blend);
+
+  // And comes back as saved, not from a stale cache entry
+  play ({ 0xc0, 1, 0xc0, 0 });
+  CHECK (Synth::settings.patch () == blend);
+}
+
+// Voice 1 sounding at the frequency it was given
+static bool held (uint16_t frequency)
+{
+  return (reg (Voice_1_freq_lo) | reg (Voice_1_freq_hi) << 8) == frequency
+      && (reg (Voice_1_control) & Gate_bit);
+}
+
+// A held note keeps its pitch and gate through every move, the first
+// full rewrite after enabling and a program change included
+static void held_note ()
+{
+  Synth::init ();
+  Synth::select_morph_source (0, Num_patches);
+  Synth::select_morph_source (1, Num_patches + 1);
+
+  play ({ 0x90, 69, 100 });
+  const uint16_t frequency = reg (Voice_1_freq_lo) | reg (Voice_1_freq_hi) << 8;
+  CHECK (held (frequency));
+
+  Synth::morph.set_enabled (true);
+  play ({ 0xb0, 1, 127 });
+  CHECK (held (frequency));
+  CHECK (playing (preset (1)));
+
+  play ({ 0xb0, 1, 0 });
+  CHECK (held (frequency));
+  CHECK (playing (preset (0)));
+
+  play ({ 0xc0, Num_patches + 2 });
+  CHECK (held (frequency));
+  play ({ 0xb0, 1, 90 });
+  CHECK (held (frequency));
+}
+
+// Off, the mod wheel leaves the program being played and edited alone
+static void disabled ()
+{
+  Synth::init ();
+  Synth::select_morph_source (0, Num_patches);
+  Synth::select_morph_source (1, Num_patches + 1);
+
+  play ({ 0xc0, Num_patches + 2 });
+  Patch before = Synth::settings.patch ();
+
+  play ({ 0xb0, 1, 64, 0xb0, 1, 127 });
+  CHECK (Synth::settings.patch () == before);
+  CHECK (playing (preset (2)));
+
+  // Switching it off keeps the last blend as the edit
+  Synth::morph.set_enabled (true);
+  play ({ 0xb0, 1, 127 });
+  CHECK (playing (preset (1)));
+  Synth::morph.set_enabled (false);
+  play ({ 0xb0, 1, 0 });
+  CHECK (playing (preset (1)));
+}
+
+int main ()
+{
+  resync ();
+  save_blend ();
+  held_note ();
+  disabled ();
+
+  printf ("morph_test: %s\n", failures ? "FAILED" : "ok");
+  return failures ? 1 : 0;
+}
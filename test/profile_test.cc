@@ -0,0 +1,44 @@
+#define PROFILE
+
+#include "check.h"
+
+// The hot path probes as compiled into make profile: each section they
+// wrap records one run per pass, whichever caller gets there.
+
+using Synth = host::Synth<host::Sid_registers>;
+
+static void hot_paths ()
+{
+  Synth::init ();
+  _profiler.reset ();
+
+  play ({ 0x90, 60, 100 });
+  CHECK (profile_stats[Probe_note_on].runs == 1);
+  CHECK (profile_stats[Probe_sid_update].runs > 0);
+}
+
+// The menu's SAVE and a press of the switch both go through
+// Settings::save, so both are timed; a preset is not saved but the call
+// still counts
+static void save ()
+{
+  Synth::init ();
+  _profiler.reset ();
+
+  CHECK (Synth::settings.save ());
+  settle ();
+  CHECK (profile_stats[Probe_save].runs == 1);
+
+  play ({ 0xc0, Num_patches });
+  CHECK (!Synth::settings.save ());
+  CHECK (profile_stats[Probe_save].runs == 2);
+}
+
+int main ()
+{
+  hot_paths ();
+  save ();
+
+  printf ("profile_test: %s\n", failures ? "FAILED" : "ok");
+  return failures ? 1 : 0;
+}
@@ -0,0 +1,115 @@
+#include "check.h"
+#include "sid_emulator.h"
+
+// The envelope generator of the SID emulator against the chip's rate
+// counter periods, and notes reaching it through the firmware's Engine as
+// the renderer plays them.
+
+using Synth = host::Synth<host::Emulator_device>;
+
+static uint32_t run_until_level (host::Sid_emulator & sid, uint8_t voice, uint8_t level, uint32_t limit)
+{
+  uint32_t cycles = 0;
+
+  while (sid.envelope (voice) != level && cycles < limit)
+  {
+    sid.clock ();
+    cycles++;
+  }
+
+  return cycles;
+}
+
+// Each attack step takes one rate period, 255 of them from silence
+static void attack ()
+{
+  for (uint8_t rate : { 0, 3, 9 })
+  {
+    host::Sid_emulator sid;
+
+    sid.write (Voice_1_ad, rate << 4);
+    sid.write (Voice_1_sr, 0xf0);
+    sid.write (Voice_1_control, Gate_bit);
+
+    CHECK (run_until_level (sid, 0, 0xff, 1000000) == 255u * host::envelope_periods[rate]);
+  }
+}
+
+// Decay stops at the sustain level and holds while the gate is on
+static void sustain ()
+{
+  host::Sid_emulator sid;
+
+  sid.write (Voice_2_ad, 0x01);
+  sid.write (Voice_2_sr, 0x80);
+  sid.write (Voice_2_control, Gate_bit);
+
+  CHECK (run_until_level (sid, 1, 0x88, 1000000) < 1000000);
+
+  for (uint32_t i = 0; i < 100000; ++i)
+  {
+    sid.clock ();
+  }
+
+  CHECK (sid.envelope (1) == 0x88);
+}
+
+// Gate off releases from the current level, at the release rate and
+// slowing down below 0x5d; gate on again attacks from where it is
+static void release ()
+{
+  host::Sid_emulator sid;
+  const uint8_t rate = 2;
+  const uint16_t period = host::envelope_periods[rate];
+
+  sid.write (Voice_3_ad, 0x00);
+  sid.write (Voice_3_sr, 0xf0 | rate);
+  sid.write (Voice_3_control, Gate_bit);
+  run_until_level (sid, 2, 0xff, 1000000);
+
+  sid.write (Voice_3_control, 0);
+  uint32_t fast = run_until_level (sid, 2, 0x5d, 1000000);
+  uint32_t slow = run_until_level (sid, 2, 0x36, 1000000);
+
+  CHECK (fast + period > (0xffu - 0x5d) * period && fast <= (0xffu - 0x5d) * period);
+  CHECK (slow == (0x5du - 0x36) * period * 2);
+
+  sid.write (Voice_3_control, Gate_bit);
+
+  for (uint32_t i = 0; i < host::envelope_periods[0]; ++i)
+  {
+    sid.clock ();
+  }
+
+  CHECK (sid.envelope (2) == 0x37);
+}
+
+// The renderer's path: channels past the third play the first voice
+static void through_engine ()
+{
+  host::Sid_emulator sid;
+  host::Emulator_device::emulator = & sid;
+  Synth::init ();
+
+  const uint8_t on[]  = { 0x95, 60, 100 };
+  const uint8_t off[] = { 0x85, 60, 0 };
+
+  host::play<host::Emulator_device> (on, sizeof (on));
+  run_until_level (sid, 0, 0xff, 1000000);
+  CHECK (sid.envelope (0) == 0xff);
+  CHECK (sid.envelope (1) == 0);
+
+  host::play<host::Emulator_device> (off, sizeof (off));
+  CHECK (run_until_level (sid, 0, 0, 10000000) < 10000000);
+}
+
+int main ()
+{
+  attack ();
+  sustain ();
+  release ();
+  through_engine ();
+
+  printf ("sid_emulator_test: %s\n", failures ? "FAILED" : "ok");
+  return failures ? 1 : 0;
+}
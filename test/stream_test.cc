@@ -0,0 +1,227 @@
+#include <avr/io.h>
+#include "stream.h"
+#include "check.h"
+
+// Feeds register stream frames through the parser into a Sid image and
+// checks what reaches the bus, and the counters for broken, lost and late
+// frames.
+
+// Records bus writes in the order they happen
+struct Bus
+{
+  static void write (uint8_t address, uint8_t data)
+  {
+    writes.push_back (address);
+    registers[address] = data;
+  }
+
+  static std::vector<uint8_t> writes;
+  static uint8_t              registers[Last_register];
+};
+
+std::vector<uint8_t> Bus::writes;
+uint8_t              Bus::registers[Last_register];
+
+typedef std::vector<uint8_t> Bytes;
+
+static const uint16_t Frame_counts = 256;  // 4096 us in 16 us counts
+
+static Bytes frame (uint8_t sequence, const Bytes & pairs)
+{
+  Bytes out { Stream_sync, sequence, (uint8_t) (pairs.size () / 2) };
+  uint8_t sum = sequence + out[2];
+
+  for (auto b : pairs)
+  {
+    out.push_back (b);
+    sum += b;
+  }
+
+  out.push_back (-sum);
+  return out;
+}
+
+struct Receiver
+{
+  Receiver ()
+    : stream (serial)
+    , now (0)
+    , frames (0)
+  {
+    Bus::writes.clear ();
+  }
+
+  // Lets time pass with the frame task polling the stream
+  void wait (uint32_t counts)
+  {
+    for (; counts >= Frame_counts; counts -= Frame_counts)
+    {
+      now += Frame_counts;
+      stream.poll (now);
+    }
+
+    now += counts;
+  }
+
+  // Delivers bytes, flushing each complete frame like the firmware does
+  void feed (const Bytes & bytes)
+  {
+    data = bytes;
+    serial.feed (data.data (), data.size ());
+
+    while (serial.available ())
+    {
+      if (stream.process_next (now))
+      {
+        stream.apply (sid);
+        sid.update ();
+        frames++;
+      }
+    }
+  }
+
+  host::Serial                  serial;
+  Register_stream<host::Serial> stream;
+  Sid<Bus>                      sid;
+  Bytes                         data;
+  uint16_t                      now;
+  uint32_t                      frames;
+};
+
+static void applies_whole_frames ()
+{
+  Receiver r;
+  auto f = frame (0, { Voice_3_ad, 0x21, Voice_1_freq_hi, 0x1c, Voice_1_freq_lo, 0xd6, Filter_mode_vol, 0x1f });
+
+  // Nothing is written until the check byte is in
+  r.feed (Bytes (f.begin (), f.end () - 1));
+  CHECK (r.frames == 0);
+  CHECK (Bus::writes.empty ());
+
+  r.feed (Bytes (f.end () - 1, f.end ()));
+  CHECK (r.frames == 1);
+  CHECK ((Bus::writes == Bytes { Voice_1_freq_lo, Voice_1_freq_hi, Voice_3_ad, Filter_mode_vol }));
+  CHECK (Bus::registers[Voice_1_freq_hi] == 0x1c);
+  CHECK (Bus::registers[Voice_3_ad] == 0x21);
+
+  // Unchanged registers stay off the bus, the last write in a frame wins
+  Bus::writes.clear ();
+  r.feed (frame (1, { Voice_1_freq_lo, 0xd6, Voice_2_pw_lo, 0x10, Voice_2_pw_lo, 0x80 }));
+  CHECK ((Bus::writes == Bytes { Voice_2_pw_lo }));
+  CHECK (Bus::registers[Voice_2_pw_lo] == 0x80);
+
+  // Empty frames keep the sequence and timing going
+  r.feed (frame (2, {}));
+  CHECK (r.frames == 3);
+  CHECK (r.stream.stats ().errors == 0);
+  CHECK (r.stream.stats ().lost == 0);
+}
+
+static void rejects_broken_frames ()
+{
+  Receiver r;
+
+  // Bad check byte
+  auto bad = frame (0, { Voice_1_control, 0x41 });
+  bad.back () ^= 1;
+  r.feed (bad);
+  CHECK (r.frames == 0);
+  CHECK (r.stream.stats ().errors == 1);
+
+  // Register out of range, and more pairs than registers
+  r.feed (frame (1, { Last_register, 0x00 }));
+  r.feed ({ Stream_sync, 2, Last_register + 1 });
+  CHECK (r.frames == 0);
+  CHECK (r.stream.stats ().errors == 3);
+  CHECK (Bus::writes.empty ());
+
+  // A frame cut short by the next one is dropped, the next one is not
+  auto cut = frame (3, { Voice_1_control, 0x41, Voice_1_ad, 0x09 });
+  cut.resize (5);
+  auto next = frame (4, { Voice_1_control, 0x11 });
+  cut.insert (cut.end (), next.begin (), next.end ());
+  r.feed (cut);
+  CHECK (r.frames == 1);
+  CHECK (r.stream.stats ().errors == 4);
+  CHECK ((Bus::writes == Bytes { Voice_1_control }));
+  CHECK (Bus::registers[Voice_1_control] == 0x11);
+
+  // Garbage between frames is skipped
+  r.feed ({ 0x00, 0x13, 0x7f });
+  r.feed (frame (5, { Voice_1_control, 0x10 }));
+  CHECK (r.frames == 2);
+}
+
+static void counts_lost_and_late_frames ()
+{
+  Receiver r;
+  const uint16_t period = 1250;  // 50 Hz in 16 us counts
+
+  for (uint8_t seq = 0; seq < 10; ++seq)
+  {
+    r.feed (frame (seq, {}));
+    r.now += period;
+  }
+
+  CHECK (r.stream.stats ().lost == 0);
+  CHECK (r.stream.stats ().underruns == 0);
+
+  // Three frames never arrive
+  r.feed (frame (13, {}));
+  CHECK (r.stream.stats ().lost == 3);
+
+  // A slow frame, then back on time
+  r.now += period * 2;
+  r.feed (frame (14, {}));
+  r.now += period;
+  r.feed (frame (15, {}));
+  CHECK (r.stream.stats ().underruns == 1);
+
+  // Jitter is not an underrun
+  for (uint8_t seq = 16; seq < 40; ++seq)
+  {
+    r.now += period + (seq & 1 ? 200 : -200);
+    r.feed (frame (seq, {}));
+  }
+
+  CHECK (r.stream.stats ().underruns == 1);
+
+  // The sequence number wraps
+  for (uint16_t seq = 40; seq < 300; ++seq)
+  {
+    r.now += period;
+    r.feed (frame (seq, {}));
+  }
+
+  CHECK (r.stream.stats ().lost == 3);
+
+  // After a pause playback starts over
+  r.wait (Stream_restart);
+  r.feed (frame (0, {}));
+  CHECK (r.stream.stats ().lost == 3);
+  CHECK (r.stream.stats ().underruns == 1);
+
+  // Also when the pause wraps the clock: 1.2 s reads as 0.15 s
+  for (uint8_t seq = 1; seq < 10; ++seq)
+  {
+    r.now += period;
+    r.feed (frame (seq, {}));
+  }
+
+  r.wait (75000);
+  r.feed (frame (20, {}));
+  r.now += period;
+  r.feed (frame (21, {}));
+  CHECK (r.stream.stats ().lost == 3);
+  CHECK (r.stream.stats ().underruns == 1);
+}
+
+int main ()
+{
+  applies_whole_frames ();
+  rejects_broken_frames ();
+  counts_lost_and_late_frames ();
+
+  printf ("stream_test: %s\n", failures ? "FAILED" : "ok");
+  return failures ? 1 : 0;
+}
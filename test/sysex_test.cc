@@ -0,0 +1,390 @@
+#include <string.h>
+#include "check.h"
+#include "sysex_messages.h"
+
+// System exclusive patch and parameter messages through Midi<> into the
+// synth: patches land in the bank or the edit buffer intact, broken or
+// foreign messages change nothing, and a patch arriving while the bank
+// is writing waits for it.
+
+using Synth = host::Synth<host::Sid_registers>;
+
+static Patch preset (uint8_t index)
+{
+  Patch patch;
+  memcpy_P (& patch, & presets[index].patch, sizeof (patch));
+  return patch;
+}
+
+static Patch stored (uint8_t program)
+{
+  Patch patch;
+  Synth::settings.read (program, patch);
+  return patch;
+}
+
+static void edit_buffer ()
+{
+  Synth::init ();
+
+  // Bytes with the top bit set go through the packing
+  auto bass = preset (0);
+  play (host::patch_message (Sysex_edit_buffer, bass));
+
+  CHECK (Synth::sysex.received () == 1);
+  CHECK (Synth::settings.patch () == bass);
+  CHECK (host::Sid_registers::registers[Voice_1_sr] == 0x84);
+  CHECK (!Synth::settings.saving ());
+  CHECK (stored (0) != bass);
+}
+
+static void bank ()
+{
+  Synth::init ();
+
+  // A whole bank, waiting for each write, the current program last
+  for (uint8_t program = Num_patches; program-- > 0;)
+  {
+    play (host::patch_message (program, preset (program % Num_presets)));
+    settle ();
+  }
+
+  CHECK (Synth::sysex.received () == Num_patches);
+  CHECK (Synth::sysex.errors () == 0);
+
+  for (uint8_t program = 0; program < Num_patches; ++program)
+  {
+    CHECK (stored (program) == preset (program % Num_presets));
+  }
+
+  CHECK (Synth::settings.patch () == preset (0));
+
+  // Out of range values are replaced before storing
+  auto bad = preset (1);
+  bad.data[Patch_res_mode] |= 0x03;
+  play (host::patch_message (5, bad));
+  settle ();
+
+  auto fixed = stored (5);
+  CHECK (fixed != bad);
+  CHECK ((fixed.data[Patch_res_mode] & 0x03) == (default_patch.data[Patch_res_mode] & 0x03));
+  CHECK (fixed.data[Patch_cutoff] == bad.data[Patch_cutoff]);
+}
+
+// A patch for the program being played replaces the sound at once, and
+// what is stored is what comes back when the program is selected again
+static void current_program ()
+{
+  Synth::init ();
+  auto lead = preset (1);
+  auto bass = preset (0);
+
+  play ({ 0xc0, 3 });
+  auto redraws = Synth::redraws;
+
+  play (host::patch_message (3, lead));
+  CHECK (Synth::settings.patch () == lead);
+  Register_image image;
+  image.decode (lead);
+  CHECK (reg (Voice_1_ad) == image.regs[Voice_1_ad]);
+  CHECK (reg (Voice_1_sr) == image.regs[Voice_1_sr]);
+  CHECK (Synth::redraws == redraws + 1);
+  settle ();
+
+  // Another program is stored without touching the sound
+  play (host::patch_message (4, bass));
+  CHECK (Synth::settings.patch () == lead);
+  settle ();
+
+  // Both were decoded ahead before they were stored
+  play ({ 0xc0, 4 });
+  CHECK (Synth::settings.patch () == bass);
+  play ({ 0xc0, 3 });
+  CHECK (Synth::settings.patch () == lead);
+}
+
+static void broken_messages ()
+{
+  Synth::init ();
+  auto before = Synth::settings.patch ();
+  auto lead = preset (1);
+
+  // Bad check byte
+  auto m = host::patch_message (Sysex_edit_buffer, lead);
+  m[m.size () - 2] ^= 1;
+  play (m);
+  CHECK (Synth::sysex.errors () == 1);
+
+  // Cut short by a note
+  m = host::patch_message (Sysex_edit_buffer, lead);
+  m.resize (12);
+  m.insert (m.end (), { 0x90, 60, 100 });
+  play (m);
+  CHECK (Synth::sysex.errors () == 2);
+
+  // Program past the bank, and an unknown command
+  play (host::patch_message (Num_patches, lead));
+  play ({ 0xf0, Sysex_manufacturer, Sysex_device, 0x55, 0x00, 0xf7 });
+  CHECK (Synth::sysex.errors () == 4);
+
+  // Someone else's message is not an error
+  m = host::patch_message (Sysex_edit_buffer, lead);
+  m[1] = 0x41;
+  play (m);
+  play ({ 0xf0, 0xf7 });
+  CHECK (Synth::sysex.errors () == 4);
+
+  CHECK (Synth::sysex.received () == 0);
+  CHECK (Synth::settings.patch () == before);
+
+  // Real time bytes may come in the middle
+  m = host::patch_message (Sysex_edit_buffer, lead);
+  m.insert (m.begin () + 10, 0xf8);
+  m.insert (m.begin () + 4, 0xfe);
+  play (m);
+  CHECK (Synth::sysex.received () == 1);
+  CHECK (Synth::settings.patch () == lead);
+}
+
+static void parameter_changes ()
+{
+  Synth::init ();
+
+  play (host::parameter_message (FILTER_CUTOFF, 0, 100));
+  play (host::parameter_message (VOICE_ATTACK, 2, 9));
+  CHECK (Synth::sysex.received () == 2);
+  CHECK (Synth::settings.get (FILTER_CUTOFF, 0) == 100);
+  CHECK (Synth::settings.get (VOICE_ATTACK, 2) == 9);
+  CHECK (host::Sid_registers::registers[Filter_cutoff_hi] == 100);
+  CHECK (host::Sid_registers::registers[Voice_3_ad] >> 4 == 9);
+
+  // Unknown setting, voice out of range, value out of range
+  play (host::parameter_message (Num_settings, 0, 0));
+  play (host::parameter_message (FILTER_CUTOFF, 1, 0));
+  play (host::parameter_message (VOICE_ATTACK, 0, 16));
+  CHECK (Synth::sysex.errors () == 3);
+  CHECK (Synth::settings.get (VOICE_ATTACK, 0) != 16);
+}
+
+// The firmware's EEPROM is slow: one patch waits, the next is turned away
+static void busy_bank ()
+{
+  Synth::init ();
+  Settings settings;
+  settings.init ();
+
+  CHECK (settings.store (1, preset (0)));
+  CHECK (settings.store (2, preset (1)));
+  CHECK (!settings.store (3, preset (2)));
+
+  while (settings.saving ())
+  {
+    EE_READY_vect ();
+    settings.poll ();
+  }
+
+  Patch patch;
+  settings.read (1, patch);
+  CHECK (patch == preset (0));
+  settings.read (2, patch);
+  CHECK (patch == preset (1));
+}
+
+// Programs and morph sources that need the bank while it is writing are
+// read once the write is done, never in between
+static void reads_after_write ()
+{
+  Synth::init ();
+
+  // The record of program 5 is half written when it is selected
+  play (host::patch_message (5, preset (2)));
+  CHECK (Synth::settings.saving ());
+
+  play ({ 0xc0, 5 });
+  Synth::select_morph_source (1, 5);
+  CHECK (Synth::settings.program () == 0);
+  CHECK (Synth::selected_program () == 5);
+
+  settle ();
+  play ({});
+  CHECK (Synth::settings.program () == 5);
+  CHECK (Synth::settings.patch () == preset (2));
+
+  // The morph lands on the source read after the write
+  play ({});
+  Synth::morph.set_enabled (true);
+  play ({ 0xb0, 1, 127 });
+  Register_image image;
+  image.decode (preset (2));
+  CHECK (reg (Voice_1_ad) == image.regs[Voice_1_ad]);
+  CHECK (reg (Voice_1_sr) == image.regs[Voice_1_sr]);
+
+  // Presets are not in the bank
+  play (host::patch_message (7, preset (0)));
+  play ({ 0xc0, Num_patches + 1 });
+  CHECK (Synth::settings.saving ());
+  CHECK (Synth::settings.program () == Num_patches + 1);
+}
+
+// Sent Record_write_ms apart, as host/sysex.cc advises, the bank keeps up
+// with any number of patches; much faster and the second in waiting is
+// turned away
+static void paced_bank ()
+{
+  for (uint32_t gap : { (uint32_t) Record_write_ms, (uint32_t) 100 })
+  {
+    Synth::init ();
+
+    for (uint8_t round = 0; round < 3; ++round)
+    {
+      for (uint8_t program = 0; program < Num_patches; ++program)
+      {
+        auto m = host::patch_message (program, preset ((program + round) % Num_presets));
+        host::play<host::Sid_registers> (m.data (), m.size ());
+        Synth::run_until (_host_time + gap * 1000);
+      }
+    }
+
+    settle ();
+
+    if (gap == Record_write_ms)
+    {
+      CHECK (Synth::sysex.errors () == 0);
+
+      for (uint8_t program = 0; program < Num_patches; ++program)
+      {
+        CHECK (stored (program) == preset ((program + 2) % Num_presets));
+      }
+    }
+
+    else
+    {
+      CHECK (Synth::sysex.errors () > 0);
+    }
+  }
+}
+
+// A unit fresh from the programmer has an all 0xff EEPROM: nothing is
+// stored and every bank program is the default patch and bindings
+static void blank_bank ()
+{
+  Synth::init ();
+
+  for (uint8_t program = 0; program < Num_patches; ++program)
+  {
+    Patch patch;
+    Cc_bindings controls;
+    Synth::settings.read (program, patch, controls);
+    CHECK (patch == default_patch);
+    CHECK (memcmp (& controls, & default_cc_bindings, sizeof (controls)) == 0);
+  }
+
+  CHECK (Synth::settings.patch () == default_patch);
+  CHECK (reg (Filter_res_en) == (default_patch.data[Patch_res_mode] & 0xf0));
+}
+
+static void write_record (uint8_t slot, uint8_t program, uint16_t sequence, const Patch & patch)
+{
+  Patch_record r {};
+  r.patch = patch;
+  r.controls = default_cc_bindings;
+  r.program = program;
+  r.sequence = sequence;
+  r.version = Patch_version;
+  r.crc = record_crc (r);
+  memcpy (& eeprom_bank[slot], & r, sizeof (r));
+}
+
+// The log wrapped round the slots while the sequence crossed 0x8000: the
+// newest record is the one after 0x7fff, and the next save follows it
+static void sequence_wrap ()
+{
+  Synth::init ();
+  write_record (5, 0, 0x7ffe, preset (0));
+  write_record (6, 1, 0x7fff, preset (1));
+  write_record (0, 0, 0x8000, preset (2));
+  write_record (1, 1, 0x8001, preset (3));
+
+  Bank bank;
+  bank.init ();
+
+  Patch patch;
+  CHECK (bank.load (0, patch) && patch == preset (2));
+  CHECK (bank.load (1, patch) && patch == preset (3));
+
+  CHECK (bank.save (2, preset (0), default_cc_bindings));
+
+  while (_eeprom_queue.busy ())
+  {
+    EE_READY_vect ();
+  }
+
+  CHECK (bank.poll ());
+  CHECK (eeprom_bank[2].program == 2);
+  CHECK (eeprom_bank[2].sequence == 0x8002);
+}
+
+static uint16_t frequency (uint8_t voice)
+{
+  return reg (Voice_1_freq_lo + voice * 7) | reg (Voice_1_freq_hi + voice * 7) << 8;
+}
+
+static bool gate (uint8_t voice)
+{
+  return reg (Control_registers[voice]) & Gate_bit;
+}
+
+// A program change or a new edit buffer under a held note changes the
+// sound and leaves the note's pitch and gate; released voices take the
+// whole patch
+static void held_notes ()
+{
+  Synth::init ();
+  play (host::patch_message (3, preset (2)));
+  settle ();
+
+  play ({ 0x90, 69, 100, 0x91, 57, 100, 0x81, 57, 0 });
+  const uint16_t a4 = frequency (0);
+  CHECK (gate (0) && !gate (1));
+
+  // From the bank, then from the cache
+  for (uint8_t program : { 3, Num_patches + 1, 3 })
+  {
+    play ({ 0xc0, program });
+    Register_image image;
+    image.decode (Synth::settings.patch ());
+
+    CHECK (frequency (0) == a4 && gate (0));
+    CHECK (reg (Voice_1_ad) == image.regs[Voice_1_ad]);
+    CHECK (reg (Voice_2_freq_lo) == image.regs[Voice_2_freq_lo]);
+    CHECK (reg (Voice_2_control) == image.regs[Voice_2_control]);
+  }
+
+  play (host::patch_message (Sysex_edit_buffer, preset (0)));
+  CHECK (Synth::settings.patch () == preset (0));
+  CHECK (frequency (0) == a4 && gate (0));
+
+  // Released, the next program has it all
+  play ({ 0x80, 69, 0, 0xc0, 3 });
+  Register_image image;
+  image.decode (preset (2));
+  CHECK (memcmp (host::Sid_registers::registers, image.regs, sizeof (image.regs)) == 0);
+}
+
+int main ()
+{
+  blank_bank ();
+  sequence_wrap ();
+  edit_buffer ();
+  bank ();
+  current_program ();
+  broken_messages ();
+  parameter_changes ();
+  busy_bank ();
+  reads_after_write ();
+  paced_bank ();
+  held_notes ();
+
+  printf ("sysex_test: %s\n", failures ? "FAILED" : "ok");
+  return failures ? 1 : 0;
+}
@@ -0,0 +1,119 @@
+#include <stdio.h>
+#include <string.h>
+#include "synth.h"
+#include "trace.h"
+
+// Golden register write tests. Each canned MIDI stream is played through
+// Midi<> and the synth with the tracing device, and the trace is checked
+// against test/golden/<name>.trace: the register file must agree after
+// every message and there may not be more writes than in the golden
+// trace. Run with --update to rewrite the golden files after an intended
+// change in output.
+
+using Synth = host::Synth<host::Trace_device>;
+
+struct Stream
+{
+  const char *    name;
+  const uint8_t * data;
+  uint32_t        length;
+};
+
+// Notes on all three voices, then released in a different order
+const uint8_t chords[] =
+{
+  0x90, 48, 100,   0x91, 52, 100,   0x92, 55, 100,
+  0x80, 48, 0,     0x82, 55, 0,     0x81, 52, 0,
+  0x90, 60, 90,    0x90, 60, 0,
+};
+
+// Program changes across user programs and presets with notes in between
+const uint8_t programs[] =
+{
+  0xc0, 16,   0x90, 36, 100,   0xc0, 17,   0x80, 36, 0,
+  0xc0, 18,   0x91, 64, 100,   0xc0, 22,   0xc0, 0,
+  0x81, 64, 0,
+};
+
+// Running status with clock and active sensing between data bytes
+const uint8_t running_status[] =
+{
+  0xfa,
+  0x90, 40, 100,   0xf8,   42, 100,   0xfe,   44, 100,
+  0xf8,   40, 0,   42, 0,   0xf8,   44, 0,
+  0xfc,
+};
+
+const Stream streams[] =
+{
+  { "chords",         chords,         sizeof (chords)         },
+  { "programs",       programs,       sizeof (programs)       },
+  { "running_status", running_status, sizeof (running_status) },
+};
+
+static int failures = 0;
+
+static host::Trace capture (const Stream & s)
+{
+  host::Trace_device::trace.clear ();
+  Synth::init ();
+  host::play<host::Trace_device> (s.data, s.length);
+  return host::Trace_device::trace;
+}
+
+int main (int argc, char * argv[])
+{
+  bool update = argc > 1 && !strcmp (argv[1], "--update");
+
+  for (auto & s : streams)
+  {
+    char path[64];
+    snprintf (path, sizeof (path), "test/golden/%s.trace", s.name);
+
+    auto trace = capture (s);
+
+    if (update)
+    {
+      FILE * f = fopen (path, "w");
+
+      if (!f)
+      {
+        printf ("%s: cannot write\n", path);
+        return 1;
+      }
+
+      host::write_text (f, trace);
+      fclose (f);
+      continue;
+    }
+
+    host::Trace golden;
+
+    if (!host::read_trace (path, golden))
+    {
+      printf ("%s: cannot read\n", path);
+      failures++;
+      continue;
+    }
+
+    auto r = host::compare (golden, trace);
+
+    if (!r.match)
+    {
+      printf ("%s: register %02x differs at %u us\n", s.name, r.address, r.time);
+      failures++;
+    }
+
+    else if (r.actual > r.expected)
+    {
+      printf ("%s: %u writes, golden has %u\n", s.name, r.actual, r.expected);
+      failures++;
+    }
+  }
+
+  if (failures)
+    return 1;
+
+  printf ("trace_test: ok\n");
+  return 0;
+}